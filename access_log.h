@@ -0,0 +1,256 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "booking_index.h"
+
+struct AccessLogOptions {
+    std::string file = "access.log";       // "" = no access log
+    size_t max_file_bytes = 64u << 20;     // rotate to file.1, file.2, ... past this
+    int keep_files = 5;                    // rotated files kept besides the live one
+    size_t ring_capacity = 4096;           // records buffered per worker (power of two)
+    std::chrono::milliseconds flush_interval{50};
+};
+
+// One request, fixed size so it can be copied into a ring slot without
+// allocating. Over-long fields are truncated.
+struct AccessRecord {
+    int64_t time_ms;       // wall clock, ms since the epoch
+    uint64_t latency_ns;
+    uint64_t bytes;
+    int status;
+    char method[8];
+    char path[96];
+    char ip[46];           // fits any IPv6 address
+};
+
+// Access log fed by the worker threads. Each worker owns a single-producer
+// ring of AccessRecords; record() copies into the next slot and publishes
+// it with one release store, so a request never waits on I/O or on another
+// worker. A background thread drains the rings every flush_interval (at
+// once again if a ring was over half full), formats the records and appends
+// them in one write, rotating the file when it grows past max_file_bytes.
+// A full ring drops the record and counts it (dropped()); the writer notes
+// each batch of drops in the log as well.
+class AccessLog {
+public:
+    explicit AccessLog(const AccessLogOptions &opts) : opts_(opts) {
+        size_t cap = 1;
+        while (cap < opts_.ring_capacity) cap <<= 1;
+        opts_.ring_capacity = cap;
+        if (opts_.file.empty()) return;
+        out_.open(opts_.file, std::ios::out | std::ios::app);
+        if (!out_) return;
+        out_.seekp(0, std::ios::end);
+        written_ = (size_t) out_.tellp();
+        enabled_ = true;
+        writer_ = std::thread(&AccessLog::writerLoop, this);
+    }
+
+    ~AccessLog() {
+        if (!writer_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        writer_.join();
+    }
+
+    AccessLog(const AccessLog &) = delete;
+    AccessLog &operator=(const AccessLog &) = delete;
+
+    void record(std::string_view method, std::string_view path, int status, uint64_t latency_ns,
+                uint64_t bytes, std::string_view ip) {
+        if (!enabled_) return;
+        Ring &r = ring();
+        uint64_t tail = r.tail.load(std::memory_order_relaxed);
+        if (tail - r.head_cache == r.mask + 1) {
+            r.head_cache = r.head.load(std::memory_order_acquire);
+            if (tail - r.head_cache == r.mask + 1) {
+                r.dropped.store(r.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        AccessRecord &rec = r.slots[tail & r.mask];
+        rec.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::system_clock::now().time_since_epoch()).count();
+        rec.latency_ns = latency_ns;
+        rec.bytes = bytes;
+        rec.status = status;
+        copy(rec.method, sizeof rec.method, method);
+        copy(rec.path, sizeof rec.path, path);
+        copy(rec.ip, sizeof rec.ip, ip);
+        r.tail.store(tail + 1, std::memory_order_release);
+    }
+
+    // Records lost to full rings since startup.
+    uint64_t dropped() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        uint64_t n = 0;
+        for (const auto &r : rings_) n += r->dropped.load(std::memory_order_relaxed);
+        return n;
+    }
+
+private:
+    struct Ring {
+        explicit Ring(size_t cap) : slots(new AccessRecord[cap]), mask(cap - 1) {}
+        std::unique_ptr<AccessRecord[]> slots;
+        const uint64_t mask;
+        // consumer and producer indexes on separate cache lines
+        alignas(64) std::atomic<uint64_t> head{0};
+        alignas(64) std::atomic<uint64_t> tail{0};
+        uint64_t head_cache = 0;              // producer's last look at head
+        std::atomic<uint64_t> dropped{0};     // written by the producer only
+        uint64_t dropped_logged = 0;          // writer thread's bookkeeping
+    };
+
+    static void copy(char *dst, size_t cap, std::string_view s) {
+        size_t n = s.size() < cap - 1 ? s.size() : cap - 1;
+        std::memcpy(dst, s.data(), n);
+        dst[n] = '\0';
+    }
+
+    // This thread's ring, registered on first use. Rings stay registered
+    // after their thread exits so nothing queued is lost.
+    Ring &ring() {
+        thread_local uint64_t owner = 0;
+        thread_local Ring *mine = nullptr;
+        if (owner != id_) {
+            auto r = std::make_unique<Ring>(opts_.ring_capacity);
+            mine = r.get();
+            owner = id_;
+            std::lock_guard<std::mutex> lock(mtx_);
+            rings_.push_back(std::move(r));
+        }
+        return *mine;
+    }
+
+    // Copies a request field into the quoted part of a line with `"`, `\`
+    // and control bytes escaped (\", \\, \xHH), so a crafted path cannot
+    // end the quote or start a forged line.
+    static void appendQuoted(std::string &out, const char *s) {
+        static const char hex[] = "0123456789abcdef";
+        for (; *s; ++s) {
+            unsigned char c = (unsigned char) *s;
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += (char) c;
+            } else if (c < 0x20 || c == 0x7f) {
+                out += "\\x";
+                out += hex[c >> 4];
+                out += hex[c & 15];
+            } else {
+                out += (char) c;
+            }
+        }
+    }
+
+    // 2026-10-17T09:30:00.123Z 203.0.113.9 "POST /book" 200 33 0.000412
+    static void format(std::string &out, const AccessRecord &r) {
+        int64_t day = r.time_ms / 86400000, ms = r.time_ms % 86400000;
+        char buf[64];
+        std::snprintf(buf, sizeof buf, "T%02d:%02d:%02d.%03dZ ", (int) (ms / 3600000),
+                      (int) (ms / 60000 % 60), (int) (ms / 1000 % 60), (int) (ms % 1000));
+        out += format_date((int) day);
+        out += buf;
+        out += r.ip;
+        out += " \"";
+        appendQuoted(out, r.method);
+        out += ' ';
+        appendQuoted(out, r.path);
+        std::snprintf(buf, sizeof buf, "\" %d %llu %llu.%06llu\n", r.status,
+                      (unsigned long long) r.bytes, (unsigned long long) (r.latency_ns / 1000000000),
+                      (unsigned long long) (r.latency_ns / 1000 % 1000000));
+        out += buf;
+    }
+
+    void writerLoop() {
+        std::string batch;
+        bool busy = false;
+        for (;;) {
+            bool stop;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                if (!busy) cv_.wait_for(lock, opts_.flush_interval, [this] { return stopping_; });
+                stop = stopping_;
+            }
+            busy = drain(batch);
+            if (!batch.empty()) write(batch);
+            batch.clear();
+            if (stop) return;
+        }
+    }
+
+    // Returns true if some ring was more than half full.
+    bool drain(std::string &batch) {
+        bool busy = false;
+        std::vector<Ring *> rings;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            for (auto &r : rings_) rings.push_back(r.get());
+        }
+        for (Ring *r : rings) {
+            uint64_t head = r->head.load(std::memory_order_relaxed);
+            uint64_t tail = r->tail.load(std::memory_order_acquire);
+            if (tail - head > r->mask / 2) busy = true;
+            for (; head != tail; ++head) format(batch, r->slots[head & r->mask]);
+            r->head.store(head, std::memory_order_release);
+            uint64_t dropped = r->dropped.load(std::memory_order_relaxed);
+            if (dropped != r->dropped_logged) {
+                batch += "# access log buffer full, dropped " +
+                         std::to_string(dropped - r->dropped_logged) + " records\n";
+                r->dropped_logged = dropped;
+            }
+        }
+        return busy;
+    }
+
+    void write(const std::string &batch) {
+        if (written_ > 0 && written_ + batch.size() > opts_.max_file_bytes) rotate();
+        out_.write(batch.data(), (std::streamsize) batch.size());
+        out_.flush();
+        written_ += batch.size();
+    }
+
+    // access.log -> access.log.1 -> ... -> access.log.<keep_files> (deleted)
+    void rotate() {
+        out_.close();
+        std::string oldest = opts_.file + "." + std::to_string(opts_.keep_files);
+        std::remove(oldest.c_str());
+        for (int i = opts_.keep_files - 1; i >= 1; --i) {
+            std::string from = opts_.file + "." + std::to_string(i);
+            std::rename(from.c_str(), (opts_.file + "." + std::to_string(i + 1)).c_str());
+        }
+        if (opts_.keep_files > 0) std::rename(opts_.file.c_str(), (opts_.file + ".1").c_str());
+        else std::remove(opts_.file.c_str());
+        out_.open(opts_.file, std::ios::out | std::ios::trunc);
+        written_ = 0;
+    }
+
+    static uint64_t nextId() {
+        static std::atomic<uint64_t> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const uint64_t id_ = nextId();   // tells this thread's ring apart from another instance's
+    AccessLogOptions opts_;
+    bool enabled_ = false;
+    std::ofstream out_;
+    size_t written_ = 0;
+    mutable std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    std::vector<std::unique_ptr<Ring>> rings_;
+    std::thread writer_;
+};
@@ -0,0 +1,146 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "metrics.h"
+
+struct AdmissionOptions {
+    // requests per second per client; 0 = no rate limit. Off by default:
+    // behind a load balancer every request comes from its address, so a
+    // per-IP limit needs trust_forwarded_for to mean anything
+    double rate = 0;
+    double burst = 400;           // bucket size, i.e. how far a client may run ahead
+    // concurrent requests per route (HttpMetrics::Route order); 0 = no
+    // limit, -1 = half the workers
+    int max_inflight[HttpMetrics::kRoutes] = {0, -1, -1, 0};
+    // take the client address from X-Forwarded-For (its last entry, the one
+    // our load balancer added) instead of the socket
+    bool trust_forwarded_for = false;
+};
+
+// Decides in the pre-routing handler whether a request may run:
+//  - every client IP has a token bucket refilled at `rate` per second; an
+//    empty bucket means 429 with Retry-After set to when a token is due.
+//  - each route has a cap on requests in flight, so a flood of bookings
+//    cannot take every worker and queue up behind the single writer while
+//    /rooms waits; over the cap means 503 with Retry-After: 1.
+// Buckets live in a hash map split into shards, each with its own lock, so
+// workers rarely touch the same lock. A worker holds at most one in-flight
+// slot, from admit() until release() in the post-routing handler.
+class Admission {
+public:
+    enum Verdict { Admit, RateLimited, Busy };
+
+    explicit Admission(const AdmissionOptions &opts, size_t workers) : opts_(opts) {
+        for (int r = 0; r < HttpMetrics::kRoutes; ++r) {
+            int m = opts_.max_inflight[r];
+            limit_[r] = m < 0 ? std::max<int>(1, (int) workers / 2) : m;
+        }
+    }
+
+    // retry_after receives seconds to wait for anything but Admit.
+    Verdict admit(HttpMetrics::Route route, const std::string &ip, int &retry_after) {
+        // httplib skips post-routing when a response cannot be written, so
+        // a slot still held here belongs to this thread's previous request
+        release();
+        if (opts_.rate > 0 && !take(ip, retry_after)) {
+            rate_limited_.fetch_add(1, std::memory_order_relaxed);
+            return RateLimited;
+        }
+        if (limit_[route] > 0) {
+            if (inflight_[route].fetch_add(1, std::memory_order_acq_rel) >= limit_[route]) {
+                inflight_[route].fetch_sub(1, std::memory_order_acq_rel);
+                busy_.fetch_add(1, std::memory_order_relaxed);
+                retry_after = 1;
+                return Busy;
+            }
+            held() = route;
+        }
+        return Admit;
+    }
+
+    void release() {
+        int &h = held();
+        if (h < 0) return;
+        inflight_[h].fetch_sub(1, std::memory_order_acq_rel);
+        h = -1;
+    }
+
+    // The client address the limits apply to.
+    std::string clientOf(const std::string &remote_addr, const std::string &forwarded_for) const {
+        if (!opts_.trust_forwarded_for || forwarded_for.empty()) return remote_addr;
+        size_t comma = forwarded_for.rfind(',');
+        size_t b = comma == std::string::npos ? 0 : comma + 1;
+        while (b < forwarded_for.size() && forwarded_for[b] == ' ') ++b;
+        return forwarded_for.substr(b);
+    }
+
+    uint64_t rateLimited() const { return rate_limited_.load(std::memory_order_relaxed); }
+    uint64_t busy() const { return busy_.load(std::memory_order_relaxed); }
+    int inflight(HttpMetrics::Route r) const { return inflight_[r].load(std::memory_order_relaxed); }
+
+private:
+    static const int kShards = 64;
+    static const size_t kShardSweep = 4096;   // buckets per shard before idle ones are dropped
+
+    struct Bucket {
+        double tokens;
+        int64_t last_ns;
+    };
+    struct alignas(64) Shard {
+        std::mutex mtx;
+        std::unordered_map<std::string, Bucket> buckets;
+    };
+
+    static int &held() {
+        thread_local int route = -1;
+        return route;
+    }
+
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool take(const std::string &ip, int &retry_after) {
+        int64_t now = nowNs();
+        Shard &s = shards_[std::hash<std::string>()(ip) % kShards];
+        std::lock_guard<std::mutex> lock(s.mtx);
+        auto it = s.buckets.find(ip);
+        if (it == s.buckets.end()) {
+            if (s.buckets.size() >= kShardSweep) sweep(s, now);
+            it = s.buckets.emplace(ip, Bucket{opts_.burst, now}).first;
+        }
+        Bucket &b = it->second;
+        b.tokens = std::min(opts_.burst, b.tokens + (now - b.last_ns) * 1e-9 * opts_.rate);
+        b.last_ns = now;
+        if (b.tokens >= 1) {
+            b.tokens -= 1;
+            return true;
+        }
+        retry_after = (int) ((1 - b.tokens) / opts_.rate) + 1;
+        return false;
+    }
+
+    // A bucket that has refilled completely is the same as no bucket.
+    void sweep(Shard &s, int64_t now) {
+        int64_t full_after = (int64_t) (opts_.burst / opts_.rate * 1e9);
+        for (auto it = s.buckets.begin(); it != s.buckets.end();) {
+            if (now - it->second.last_ns >= full_after) it = s.buckets.erase(it);
+            else ++it;
+        }
+    }
+
+    AdmissionOptions opts_;
+    int limit_[HttpMetrics::kRoutes];
+    std::atomic<int> inflight_[HttpMetrics::kRoutes] = {};
+    std::atomic<uint64_t> rate_limited_{0};
+    std::atomic<uint64_t> busy_{0};
+    Shard shards_[kShards];
+};
@@ -0,0 +1,102 @@
+// bench_availability.cpp
+// Times Database::findAvailable() (GET /availability) on a generated hotel
+// of 50k rooms and 2M active bookings, next to the getRooms() call that
+// fetched the whole list clients used to filter themselves.
+// Compile: g++ -std=c++17 -O2 bench_availability.cpp database.cpp -o bench_availability.exe -lsqlite3 -lpthread
+// Usage:   bench_availability.exe [rooms=50000] [bookings=2000000] [scratch.db=bench_availability.db]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "database.h"
+#include "test_util.h"
+
+static const char *const kTypes[] = {"Single", "Double", "Twin", "Suite", "Family"};
+
+// Rooms priced 1000-5950 in five types; each gets bookings/rooms two-night
+// stays, one to four free nights apart depending on the room.
+static void generate(std::ofstream &out, int rooms, long bookings) {
+    for (int id = 1; id <= rooms; ++id)
+        out << "room," << id << ',' << kTypes[id % 5] << ',' << 1000 + (id * 37) % 100 * 50 << ",1\n";
+    const int today = today_day();
+    for (long b = 0; b < bookings; ++b) {
+        int room = (int) (b % rooms) + 1;
+        int stride = 3 + room % 4;
+        int from = today + room % stride + (int) (b / rooms) * stride;
+        out << "booking,,Guest " << b << ",," << room << ',' << format_date(from) << ','
+            << format_date(from + 2) << ",active\n";
+    }
+}
+
+int main(int argc, char **argv) {
+    int rooms = argc > 1 ? std::atoi(argv[1]) : 50000;
+    long bookings = argc > 2 ? std::atol(argv[2]) : 2000000;
+    const std::string dbfile = argc > 3 ? argv[3] : "bench_availability.db";
+    remove_db(dbfile);
+    if (rooms <= 0 || bookings < 0) {
+        std::cerr << "Usage: " << argv[0] << " [rooms] [bookings] [scratch.db]\n";
+        return 2;
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto ms = [](clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+    auto t0 = clock::now();
+    {
+        Database loader;
+        ImportStats stats;
+        auto write = [&](std::ofstream &out) { generate(out, rooms, bookings); };
+        if (!loader.open(dbfile, "", 1) || !import_csv(loader, dbfile + ".csv", write, stats)) {
+            std::cerr << "Failed to load " << dbfile << ".csv\n";
+            return 1;
+        }
+    }
+    double load = ms(clock::now() - t0);
+
+    // what the index costs at startup
+    Database db;
+    t0 = clock::now();
+    if (!db.open(dbfile, "", 1)) {
+        std::cerr << "Failed to open/init DB\n";
+        return 1;
+    }
+    double open = ms(clock::now() - t0);
+    std::cout << rooms << " rooms, " << bookings << " bookings: imported in " << load << " ms, opened in "
+              << open << " ms\n";
+
+    const int from = today_day() + 10;
+    struct Case {
+        const char *name;
+        AvailabilityQuery q;
+    } cases[] = {
+        {"3 nights, any room          ", {from, from + 3, "", -1}},
+        {"3 nights, one type          ", {from, from + 3, "Suite", -1}},
+        {"3 nights, max_price 2000    ", {from, from + 3, "", 2000}},
+        {"3 nights, type + max_price  ", {from, from + 3, "Double", 2000}},
+        {"14 nights, any room         ", {from, from + 14, "", -1}},
+    };
+    const int reps = 20;
+    for (const auto &c : cases) {
+        double best = 1e9;
+        size_t found = 0;
+        for (int i = 0; i < reps; ++i) {
+            t0 = clock::now();
+            found = db.findAvailable(c.q).size();
+            best = std::min(best, ms(clock::now() - t0));
+        }
+        std::cout << "  findAvailable " << c.name << best << " ms (" << found << " rooms)\n";
+    }
+    double best = 1e9;
+    for (int i = 0; i < reps; ++i) {
+        t0 = clock::now();
+        db.getRooms();
+        best = std::min(best, ms(clock::now() - t0));
+    }
+    std::cout << "  getRooms() for client-side filtering: " << best << " ms\n";
+    db.close();
+    remove_db(dbfile);
+    return 0;
+}
@@ -0,0 +1,80 @@
+// bench_cancel.cpp
+// Times cancelling N bookings one cancelBooking() call at a time against a
+// single cancelBookings() call, on a scratch copy of the schema.
+// Compile: g++ -std=c++17 -O2 bench_cancel.cpp database.cpp -o bench_cancel.exe -lsqlite3 -lpthread
+// Usage:   bench_cancel.exe [N=500] [scratch.db=bench_cancel.db]   (run where seed.sql is)
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "database.h"
+#include "test_util.h"
+
+// N one-night bookings spread over the seed rooms, night after night.
+static bool book(Database &db, const std::vector<Room> &rooms, int n, int first_day,
+                 std::vector<int> &ids) {
+    std::vector<BookingRequest> reqs;
+    for (int i = 0; i < n; ++i) {
+        int day = first_day + i / (int) rooms.size();
+        reqs.push_back(BookingRequest{"Bench", rooms[i % rooms.size()].room_id, format_date(day),
+                                      format_date(day + 1)});
+    }
+    std::vector<BookingResult> results;
+    if (!db.bookRooms(reqs, results)) return false;
+    ids.clear();
+    for (const auto &r : results) ids.push_back(r.booking_id);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 500;
+    const std::string dbfile = argc > 2 ? argv[2] : "bench_cancel.db";
+    remove_db(dbfile);
+
+    Database db;
+    if (n <= 0 || !db.open(dbfile, "seed.sql", 1)) {
+        std::cerr << "Failed to open/init DB\n";
+        return 1;
+    }
+    std::vector<Room> rooms = db.getRooms();
+    if (rooms.empty()) {
+        std::cerr << "No rooms to book (is seed.sql here?)\n";
+        return 1;
+    }
+    const int first_day = today_day() + 30;
+    std::vector<int> ids;
+    using clock = std::chrono::steady_clock;
+    auto ms = [](clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+    if (!book(db, rooms, n, first_day, ids)) return 1;
+    auto t0 = clock::now();
+    for (int id : ids)
+        if (!db.cancelBooking(id).ok) return 1;
+    double loop = ms(clock::now() - t0);
+
+    if (!book(db, rooms, n, first_day, ids)) return 1;
+    CancelSelection by_id;
+    by_id.booking_ids = ids;
+    std::vector<BookingResult> results;
+    t0 = clock::now();
+    if (!db.cancelBookings(by_id, results)) return 1;
+    double batch = ms(clock::now() - t0);
+
+    if (!book(db, rooms, n, first_day, ids)) return 1;
+    CancelSelection by_range;
+    by_range.from = format_date(first_day);
+    by_range.to = format_date(first_day + n);
+    t0 = clock::now();
+    if (!db.cancelBookings(by_range, results) || (int) results.size() != n) return 1;
+    double range = ms(clock::now() - t0);
+
+    std::cout << "cancel " << n << " bookings:\n"
+              << "  cancelBooking() x " << n << ": " << loop << " ms\n"
+              << "  cancelBookings(ids):    " << batch << " ms (" << loop / batch << "x)\n"
+              << "  cancelBookings(range):  " << range << " ms (" << loop / range << "x)\n";
+    db.close();
+    remove_db(dbfile);
+    return 0;
+}
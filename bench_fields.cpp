@@ -0,0 +1,120 @@
+// bench_fields.cpp
+// Malformed-request throughput of the /book field handling: the old path
+// (form parsed into a std::map, room_id through a throwing std::stoi, the
+// exception caught as httplib does) against FormView + RequestFields.
+// The new path must reject every body; the old one lets some through.
+// Compile: g++ -std=c++17 -O2 bench_fields.cpp -o bench_fields.exe
+// Usage:   bench_fields.exe [iterations=1000000]
+
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include "request_fields.h"
+
+// --- the handler code /book had before request_fields.h -------------------
+
+static std::string old_url_decode(const std::string &s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '+') out.push_back(' ');
+        else if (s[i] == '%' && i + 2 < s.size()) {
+            std::string hex = s.substr(i + 1, 2);
+            char ch = (char) strtol(hex.c_str(), nullptr, 16);
+            out.push_back(ch);
+            i += 2;
+        } else {
+            out.push_back(s[i]);
+        }
+    }
+    return out;
+}
+
+static std::map<std::string, std::string> old_parse_form(const std::string &body) {
+    std::map<std::string, std::string> m;
+    size_t i = 0;
+    while (i < body.size()) {
+        size_t eq = body.find('=', i);
+        if (eq == std::string::npos) break;
+        std::string key = body.substr(i, eq - i);
+        size_t amp = body.find('&', eq + 1);
+        std::string val;
+        if (amp == std::string::npos) {
+            val = body.substr(eq + 1);
+            i = body.size();
+        } else {
+            val = body.substr(eq + 1, amp - (eq + 1));
+            i = amp + 1;
+        }
+        m[old_url_decode(key)] = old_url_decode(val);
+    }
+    return m;
+}
+
+// true if the request would have been rejected (400, or 500 from the throw)
+static bool old_rejects(const std::string &body) {
+    try {
+        auto form = old_parse_form(body);
+        std::string name = form.count("name") ? form["name"] : "";
+        int room_id = form.count("room_id") ? std::stoi(form["room_id"]) : 0;
+        return name.empty() || room_id == 0;
+    } catch (const std::exception &) {
+        return true;
+    }
+}
+
+// --- as the /book handler does it now ---------------------------------------
+
+static bool new_rejects(const std::string &body) {
+    thread_local std::string name, check_in, check_out;
+    FormView form;
+    if (!form.parse(body)) return true;
+    RequestFields f(form);
+    int room_id = 0, from = 0, to = 0;
+    return !f.text("name", name, 200) || !f.integer("room_id", room_id, 1, INT_MAX) ||
+           !f.date("check_in", from, check_in) || !f.date("check_out", to, check_out) ||
+           (to <= from && !f.fail("check_out", "must be after check_in"));
+}
+
+int main(int argc, char **argv) {
+    long n = argc > 1 ? std::atol(argv[1]) : 1000000;
+    if (n <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [iterations]\n";
+        return 2;
+    }
+    // what bots send: junk ids, out-of-range numbers, injection attempts
+    const std::string bodies[] = {
+        "name=Bot&room_id=abc%27--&check_in=2026-11-01&check_out=2026-11-03",
+        "name=Bot&room_id=99999999999999999999&check_in=2026-11-01&check_out=2026-11-03",
+        "name=Bot&room_id=1%20OR%201%3D1&check_in=x&check_out=y",
+        "name=Bot&room_id=&check_in=2026-11-01&check_out=2026-11-03",
+    };
+    const long kinds = sizeof bodies / sizeof bodies[0];
+
+    using clock = std::chrono::steady_clock;
+    double rate[2] = {};
+    long let_through = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        long rejected = 0;
+        auto t0 = clock::now();
+        for (long i = 0; i < n; ++i) {
+            const std::string &body = bodies[i % kinds];
+            rejected += pass == 0 ? old_rejects(body) : new_rejects(body);
+        }
+        double secs = std::chrono::duration<double>(clock::now() - t0).count();
+        if (pass == 0) let_through = n - rejected;
+        else if (rejected != n) {
+            std::cerr << "RequestFields accepted a malformed body\n";
+            return 1;
+        }
+        rate[pass] = n / secs;
+    }
+    std::cout << n << " malformed /book bodies on one thread:\n"
+              << "  map + std::stoi:  " << rate[0] / 1e6 << "M req/s (" << let_through << " let through)\n"
+              << "  RequestFields:    " << rate[1] / 1e6 << "M req/s (" << rate[1] / rate[0] << "x)\n";
+    return 0;
+}
@@ -0,0 +1,88 @@
+// bench_json.cpp
+// Serializes 100k rooms as the /rooms JSON array with the std::ostringstream
+// code server.cpp used to have and with JsonWriter into a reused buffer,
+// and checks both produce the same bytes.
+// Compile: g++ -std=c++17 -O2 bench_json.cpp -o bench_json.exe
+// Usage:   bench_json.exe [rooms=100000] [runs=20]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "database.h"
+#include "json_writer.h"
+
+// the /rooms body as it was built before JsonWriter
+static std::string with_ostringstream(const std::vector<Room> &rooms) {
+    std::ostringstream oss;
+    oss << "[";
+    for (size_t i = 0; i < rooms.size(); ++i) {
+        const auto &r = rooms[i];
+        oss << "{";
+        oss << "\"room_id\":" << r.room_id << ",";
+        oss << "\"type\":\"" << r.type << "\",";
+        oss << "\"price\":" << r.price << ",";
+        oss << "\"is_available\":" << r.is_available;
+        oss << "}";
+        if (i + 1 < rooms.size()) oss << ",";
+    }
+    oss << "]";
+    return oss.str();
+}
+
+// as server.cpp's write_rooms
+static void with_writer(const std::vector<Room> &rooms, std::string &buf) {
+    buf.clear();
+    JsonWriter w(buf);
+    w.beginArray();
+    for (const auto &r : rooms) {
+        w.beginObject();
+        w.key("room_id").value(r.room_id);
+        w.key("type").value(r.type);
+        w.key("price").value(r.price);
+        w.key("is_available").value(r.is_available);
+        w.endObject();
+    }
+    w.endArray();
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int runs = argc > 2 ? std::atoi(argv[2]) : 20;
+    if (n <= 0 || runs <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [rooms] [runs]\n";
+        return 2;
+    }
+    static const char *const kTypes[] = {"Single", "Double", "Deluxe Suite"};
+    std::vector<Room> rooms(n);
+    for (int i = 0; i < n; ++i) {
+        rooms[i].room_id = 100 + i;
+        rooms[i].type = kTypes[i % 3];
+        rooms[i].price = 1000 + (i * 37) % 9000;
+        rooms[i].is_available = i % 4 != 0;
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto ms = [](clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+    std::string old_body, buf;
+    double before = 1e9, after = 1e9;
+    for (int i = 0; i < runs; ++i) {
+        auto t0 = clock::now();
+        old_body = with_ostringstream(rooms);
+        before = std::min(before, ms(clock::now() - t0));
+        t0 = clock::now();
+        with_writer(rooms, buf);
+        after = std::min(after, ms(clock::now() - t0));
+    }
+    if (buf != old_body) {
+        std::cerr << "JsonWriter output differs from the ostringstream output\n";
+        return 1;
+    }
+    std::cout << n << " rooms, " << buf.size() << " bytes, best of " << runs << ":\n"
+              << "  ostringstream: " << before << " ms\n"
+              << "  JsonWriter:    " << after << " ms (" << before / after << "x)\n";
+    return 0;
+}
@@ -0,0 +1,110 @@
+// bench_statements.cpp
+// Times N book+cancel pairs with the SQL compiled on every call (prepare,
+// step, finalize, BEGIN/COMMIT through sqlite3_exec, as Database used to)
+// against the same statements prepared once and reset between uses, as
+// Database's statement cache does. Both run on one connection with
+// synchronous=OFF so compilation, not fsync, is what shows. The pairs/s of
+// Database::bookRoom()/cancelBooking() themselves are printed for reference.
+// Compile: g++ -std=c++17 -O2 bench_statements.cpp database.cpp -o bench_statements.exe -lsqlite3 -lpthread
+// Usage:   bench_statements.exe [N=20000] [scratch.db=bench_statements.db]   (run where seed.sql is)
+
+#include <sqlite3.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "database.h"
+#include "test_util.h"
+
+static const char *const kBook =
+    "INSERT INTO bookings (customer_name, room_id, check_in, check_out, status) "
+    "VALUES (?, ?, ?, ?, 'active');";
+static const char *const kCancel = "UPDATE bookings SET status = 'cancelled' WHERE booking_id = ?;";
+
+// One pair's statements; prepare() compiles them, unless `cached` is set
+// and they already are.
+struct Pair {
+    sqlite3 *db;
+    bool cached;
+    sqlite3_stmt *begin = nullptr, *commit = nullptr, *book = nullptr, *cancel = nullptr;
+
+    sqlite3_stmt *prepare(sqlite3_stmt *&st, const char *sql) {
+        if (st && cached) {
+            sqlite3_reset(st);
+            return st;
+        }
+        sqlite3_finalize(st);
+        sqlite3_prepare_v3(db, sql, -1, cached ? SQLITE_PREPARE_PERSISTENT : 0, &st, nullptr);
+        return st;
+    }
+    bool exec(sqlite3_stmt *&st, const char *sql) {
+        if (!cached) return sqlite3_exec(db, sql, nullptr, nullptr, nullptr) == SQLITE_OK;
+        return sqlite3_step(prepare(st, sql)) == SQLITE_DONE;
+    }
+    bool run(int room_id, const std::string &in, const std::string &out) {
+        if (!exec(begin, "BEGIN;")) return false;
+        sqlite3_stmt *b = prepare(book, kBook);
+        sqlite3_bind_text(b, 1, "Bench", -1, SQLITE_STATIC);
+        sqlite3_bind_int(b, 2, room_id);
+        sqlite3_bind_text(b, 3, in.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(b, 4, out.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(b) != SQLITE_DONE || !exec(commit, "COMMIT;")) return false;
+        if (!exec(begin, "BEGIN;")) return false;
+        sqlite3_stmt *c = prepare(cancel, kCancel);
+        sqlite3_bind_int64(c, 1, sqlite3_last_insert_rowid(db));
+        return sqlite3_step(c) == SQLITE_DONE && exec(commit, "COMMIT;");
+    }
+    ~Pair() {
+        for (sqlite3_stmt *st : {begin, commit, book, cancel}) sqlite3_finalize(st);
+    }
+};
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 20000;
+    const std::string dbfile = argc > 2 ? argv[2] : "bench_statements.db";
+    remove_db(dbfile);
+
+    Database db;
+    if (n <= 0 || !db.open(dbfile, "seed.sql", 1)) {
+        std::cerr << "Failed to open/init DB\n";
+        return 1;
+    }
+    std::vector<Room> rooms = db.getRooms();
+    if (rooms.empty()) {
+        std::cerr << "No rooms to book (is seed.sql here?)\n";
+        return 1;
+    }
+    const int room = rooms.front().room_id;
+    const std::string in = format_date(today_day() + 30), out = format_date(today_day() + 31);
+    using clock = std::chrono::steady_clock;
+    auto per_sec = [n](clock::duration d) { return n / std::chrono::duration<double>(d).count(); };
+
+    auto t0 = clock::now();
+    for (int i = 0; i < n; ++i) {
+        BookingResult r = db.bookRoom("Bench", room, in, out);
+        if (!r.ok || !db.cancelBooking(r.booking_id).ok) return 1;
+    }
+    double api = per_sec(clock::now() - t0);
+    db.close();
+
+    sqlite3 *conn = nullptr;
+    if (sqlite3_open(dbfile.c_str(), &conn) != SQLITE_OK) return 1;
+    sqlite3_exec(conn, "PRAGMA synchronous = OFF;", nullptr, nullptr, nullptr);
+    double rate[2] = {};
+    for (int cached = 0; cached < 2; ++cached) {
+        Pair p{conn, cached == 1};
+        t0 = clock::now();
+        for (int i = 0; i < n; ++i)
+            if (!p.run(room, in, out)) return 1;
+        rate[cached] = per_sec(clock::now() - t0);
+    }
+    sqlite3_close(conn);
+
+    std::cout << n << " book+cancel pairs:\n"
+              << "  prepared per call:  " << (long) rate[0] << " pairs/s\n"
+              << "  prepared once:      " << (long) rate[1] << " pairs/s (" << rate[1] / rate[0] << "x)\n"
+              << "  Database API:       " << (long) api << " pairs/s (file DB, group commit)\n";
+    remove_db(dbfile);
+    return 0;
+}
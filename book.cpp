@@ -1,26 +1,18 @@
 // book.cpp
-// Compile: g++ book.cpp -o book.exe -lsqlite3
+// Books a room for the nights [check_in, check_out). Uses the same
+// date-range rules as the server: rooms.is_available only says whether the
+// room is in service, and a booking fails if an active booking of the room
+// overlaps it. The check and the insert are one statement under the write
+// lock, so this cannot double-book against the server or another CGI run.
+// Compile: g++ -std=c++17 book.cpp -o book.exe -lsqlite3
 
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <sqlite3.h>
 #include <cstdlib>
-
-static std::string url_decode(const std::string &s){
-    std::string out; out.reserve(s.size());
-    for (size_t i=0;i<s.size();++i){
-        char c = s[i];
-        if (c=='+') out.push_back(' ');
-        else if (c=='%' && i+2 < s.size()){
-            std::string h = s.substr(i+1,2);
-            char ch = (char) strtol(h.c_str(), nullptr, 16);
-            out.push_back(ch);
-            i += 2;
-        } else out.push_back(c);
-    }
-    return out;
-}
+#include "booking_index.h"
+#include "form_parser.h"
 
 static std::string html_escape(const std::string &s){
     std::string o;
@@ -59,16 +51,8 @@ int main(){
     std::string method = get_env("REQUEST_METHOD");
     std::string q = get_env("QUERY_STRING");
     std::string q_room;
-    if (!q.empty()){
-        // parse query like room_id=101
-        size_t p = q.find("room_id=");
-        if (p!=std::string::npos){
-            q_room = q.substr(p+8);
-            // strip ampersand if any
-            size_t a = q_room.find('&');
-            if (a!=std::string::npos) q_room = q_room.substr(0,a);
-        }
-    }
+    FormView query;
+    if (query.parse(q)) query.get("room_id", q_room);
 
     if (method == "GET") {
         // show form (prefill room id if present)
@@ -81,8 +65,8 @@ int main(){
         std::cout << "<input name='room_id' type='number' value='" << html_escape(q_room) << "' required readonly><br>";
         std::cout << "<label>Name:</label><br><input name='name' type='text' required><br>";
         std::cout << "<label>Phone (optional):</label><br><input name='phone' type='text'><br>";
-        std::cout << "<label>Check-in:</label><br><input name='check_in' type='date'><br>";
-        std::cout << "<label>Check-out:</label><br><input name='check_out' type='date'><br>";
+        std::cout << "<label>Check-in:</label><br><input name='check_in' type='date' required><br>";
+        std::cout << "<label>Check-out:</label><br><input name='check_out' type='date' required><br>";
         std::cout << "<button type='submit' class='btn'>Confirm Booking</button>";
         std::cout << "</form></div></main><footer class='footer'><a href='/cgi-bin/rooms.exe'>Back</a></footer></body></html>";
         return 0;
@@ -92,20 +76,15 @@ int main(){
     std::string body = get_post_body();
     // parse urlencoded form: name=abc&room_id=101...
     std::string name, phone, room_id_s, check_in, check_out;
-    size_t pos = 0;
-    while (pos < body.size()){
-        size_t eq = body.find('=', pos);
-        if (eq == std::string::npos) break;
-        std::string key = body.substr(pos, eq-pos);
-        size_t amp = body.find('&', eq+1);
-        std::string val = (amp==std::string::npos) ? body.substr(eq+1) : body.substr(eq+1, amp-(eq+1));
-        if (key=="name") name = url_decode(val);
-        else if (key=="phone") phone = url_decode(val);
-        else if (key=="room_id") room_id_s = url_decode(val);
-        else if (key=="check_in") check_in = url_decode(val);
-        else if (key=="check_out") check_out = url_decode(val);
-        if (amp==std::string::npos) break;
-        pos = amp+1;
+    FormView form;
+    if (!form.parse(body) ||
+        form.get("name", name) == FormView::Found::Malformed ||
+        form.get("phone", phone) == FormView::Found::Malformed ||
+        form.get("room_id", room_id_s) == FormView::Found::Malformed ||
+        form.get("check_in", check_in) == FormView::Found::Malformed ||
+        form.get("check_out", check_out) == FormView::Found::Malformed){
+        std::cout << "<h2>Malformed form data.</h2><p><a href='/cgi-bin/book.exe'>Back</a></p>";
+        return 0;
     }
 
     if (name.empty() || room_id_s.empty()){
@@ -114,6 +93,12 @@ int main(){
     }
 
     int room_id = atoi(room_id_s.c_str());
+    int from = 0, to = 0;
+    if (!parse_date(check_in, from) || !parse_date(check_out, to) || to <= from){
+        std::cout << "<h2>Check-in and check-out must be dates (YYYY-MM-DD), check-out after check-in.</h2>"
+                  << "<p><a href='/cgi-bin/rooms.exe'>Back</a></p>";
+        return 0;
+    }
 
     sqlite3 *db = nullptr;
     if (sqlite3_open("C:\\xampp\\htdocs\\hotel.db", &db) != SQLITE_OK) {
@@ -121,7 +106,7 @@ int main(){
         return 0;
     }
 
-    // check availability
+    // is the room in service
     const char *chk_sql = "SELECT is_available FROM rooms WHERE room_id = ?;";
     sqlite3_stmt *chk = nullptr;
     if (sqlite3_prepare_v2(db, chk_sql, -1, &chk, nullptr) != SQLITE_OK){
@@ -140,16 +125,23 @@ int main(){
     int avail = sqlite3_column_int(chk,0);
     sqlite3_finalize(chk);
     if (!avail){
-        std::cout << "<h2>Room is not available.</h2><p><a href='/cgi-bin/rooms.exe'>Back</a></p>";
+        std::cout << "<h2>Room is out of service.</h2><p><a href='/cgi-bin/rooms.exe'>Back</a></p>";
         sqlite3_close(db);
         return 0;
     }
 
-    // begin transaction
-    sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+    // take the write lock before the overlap check
+    sqlite3_busy_timeout(db, 5000);
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK){
+        std::cout << "<h2>Database is busy, please try again.</h2><p><a href='/cgi-bin/rooms.exe'>Back</a></p>";
+        sqlite3_close(db);
+        return 0;
+    }
 
-    // insert booking
-    const char *ins_sql = "INSERT INTO bookings (customer_name, phone, room_id, check_in, check_out, status) VALUES (?, ?, ?, ?, ?, 'active');";
+    // insert booking unless an active booking of the room overlaps it
+    const char *ins_sql = "INSERT INTO bookings (customer_name, phone, room_id, check_in, check_out, status) "
+                          "SELECT ?1, ?2, ?3, ?4, ?5, 'active' WHERE NOT EXISTS (SELECT 1 FROM bookings "
+                          "WHERE room_id = ?3 AND status = 'active' AND check_in < ?5 AND check_out > ?4);";
     sqlite3_stmt *ins = nullptr;
     if (sqlite3_prepare_v2(db, ins_sql, -1, &ins, nullptr) != SQLITE_OK){
         std::cout << "<h2>DB error (prepare insert)</h2>";
@@ -172,18 +164,20 @@ int main(){
     }
     sqlite3_finalize(ins);
 
+    if (sqlite3_changes(db) == 0){
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        std::cout << "<h2>Room is already booked for some of those nights.</h2><p><a href='/cgi-bin/rooms.exe'>Back</a></p>";
+        sqlite3_close(db);
+        return 0;
+    }
     int booking_id = (int)sqlite3_last_insert_rowid(db);
 
-    // mark room not available
-    const char *upd_sql = "UPDATE rooms SET is_available = 0 WHERE room_id = ?;";
-    sqlite3_stmt *upd = nullptr;
-    if (sqlite3_prepare_v2(db, upd_sql, -1, &upd, nullptr) == SQLITE_OK){
-        sqlite3_bind_int(upd, 1, room_id);
-        sqlite3_step(upd);
-        sqlite3_finalize(upd);
+    if (sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK){
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        std::cout << "<h2>Failed to save booking.</h2><p><a href='/cgi-bin/rooms.exe'>Back</a></p>";
+        sqlite3_close(db);
+        return 0;
     }
-
-    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
     sqlite3_close(db);
 
     std::cout << "<!doctype html><html><head><meta charset='utf-8'><title>Booked</title>"
@@ -191,6 +185,7 @@ int main(){
               << "<div class='card'><h2>Booking Successful!</h2>"
               << "<p>Booking ID: <strong>" << booking_id << "</strong></p>"
               << "<p>Room: <strong>" << room_id << "</strong></p>"
+              << "<p>Nights: " << html_escape(check_in) << " to " << html_escape(check_out) << "</p>"
               << "<p>Name: " << html_escape(name) << "</p>"
               << "<a class='btn' href='/cgi-bin/rooms.exe'>View Rooms</a> "
               << "<a class='btn outline' href='/index.html'>Home</a>"
@@ -0,0 +1,228 @@
+#pragma once
+#include <charconv>
+#include <string>
+#include <vector>
+#include "booking_index.h"
+#include "database.h"
+#include "import_reader.h"
+
+namespace booking_batch_detail {
+using import_detail::read_string;
+using import_detail::skip_ws;
+
+// Skips any JSON value; depth bounds the nesting a client can make us
+// recurse through.
+inline bool skip_value(const std::string &s, size_t &i, int depth = 0) {
+    skip_ws(s, i);
+    if (i >= s.size() || depth > 32) return false;
+    char c = s[i];
+    if (c == '"') {
+        std::string ignored;
+        return read_string(s, i, ignored);
+    }
+    if (c == '{' || c == '[') {
+        char end = c == '{' ? '}' : ']';
+        ++i;
+        skip_ws(s, i);
+        if (i < s.size() && s[i] == end) { ++i; return true; }
+        for (;;) {
+            if (c == '{') {
+                std::string key;
+                skip_ws(s, i);
+                if (!read_string(s, i, key)) return false;
+                skip_ws(s, i);
+                if (i >= s.size() || s[i++] != ':') return false;
+            }
+            if (!skip_value(s, i, depth + 1)) return false;
+            skip_ws(s, i);
+            if (i < s.size() && s[i] == ',') { ++i; continue; }
+            if (i < s.size() && s[i] == end) { ++i; return true; }
+            return false;
+        }
+    }
+    size_t start = i;
+    while (i < s.size() && s[i] != ',' && s[i] != '}' && s[i] != ']' && s[i] != ' ' &&
+           s[i] != '\t' && s[i] != '\r' && s[i] != '\n')
+        ++i;
+    return i > start;
+}
+
+inline bool read_int(const std::string &s, size_t &i, int &out) {
+    skip_ws(s, i);
+    auto r = std::from_chars(s.data() + i, s.data() + s.size(), out);
+    if (r.ec != std::errc()) return false;
+    i = r.ptr - s.data();
+    return true;
+}
+
+// Walks the members of the object at s[i], calling member(key) with i on
+// each value; member must consume the value and return false on error.
+template <class F>
+inline bool read_object(const std::string &s, size_t &i, F member) {
+    skip_ws(s, i);
+    if (i >= s.size() || s[i] != '{') return false;
+    ++i;
+    skip_ws(s, i);
+    if (i < s.size() && s[i] == '}') { ++i; return true; }
+    std::string key;
+    for (;;) {
+        key.clear();
+        skip_ws(s, i);
+        if (!read_string(s, i, key)) return false;
+        skip_ws(s, i);
+        if (i >= s.size() || s[i++] != ':') return false;
+        skip_ws(s, i);
+        if (!member(key)) return false;
+        skip_ws(s, i);
+        if (i < s.size() && s[i] == ',') { ++i; continue; }
+        if (i < s.size() && s[i] == '}') { ++i; return true; }
+        return false;
+    }
+}
+}
+
+// Body of POST /book/batch:
+//   {"name": "Tour group",
+//    "bookings": [{"room_id": 101, "check_in": "2026-11-01", "check_out": "2026-11-03"},
+//                 {"room_id": 102, "check_in": "2026-11-01", "check_out": "2026-11-03",
+//                  "name": "Driver"}]}
+// The top-level name goes on every booking without one of its own. Unknown
+// keys are skipped. On error `field` names the offending value, e.g.
+// "bookings[3].check_in", and `reason` says what is wrong with it.
+inline bool parse_booking_batch(const std::string &body, size_t max_items, std::vector<BookingRequest> &out,
+                                std::string &field, const char *&reason) {
+    using namespace booking_batch_detail;
+    out.clear();
+    field.clear();
+    std::string group_name;
+    std::vector<bool> named;
+    size_t i = 0;
+    auto fail = [&](std::string f, const char *why) {
+        field = std::move(f);
+        reason = why;
+        return false;
+    };
+    auto item_field = [&](const char *name) {
+        return "bookings[" + std::to_string(out.size() - 1) + "]." + name;
+    };
+    bool have_bookings = false;
+    bool ok = read_object(body, i, [&](const std::string &key) {
+        if (key == "name") {
+            if (!read_string(body, i, group_name)) return fail("name", "must be a string");
+            return true;
+        }
+        if (key != "bookings") return skip_value(body, i) || fail(key, "is not valid JSON");
+        have_bookings = true;
+        if (i >= body.size() || body[i] != '[') return fail("bookings", "must be an array");
+        ++i;
+        skip_ws(body, i);
+        if (i < body.size() && body[i] == ']') { ++i; return true; }
+        for (;;) {
+            if (out.size() == max_items) return fail("bookings", "has too many entries");
+            out.emplace_back();
+            named.push_back(false);
+            BookingRequest &b = out.back();
+            bool item_ok = read_object(body, i, [&](const std::string &k) {
+                if (k == "room_id") {
+                    if (!read_int(body, i, b.room_id) || b.room_id < 1)
+                        return fail(item_field("room_id"), "must be a positive integer");
+                } else if (k == "check_in" || k == "check_out" || k == "name") {
+                    std::string &v = k == "check_in" ? b.check_in : k == "check_out" ? b.check_out : b.name;
+                    if (!read_string(body, i, v)) return fail(item_field(k.c_str()), "must be a string");
+                    if (k == "name") named.back() = true;
+                } else if (!skip_value(body, i)) {
+                    return fail(item_field(k.c_str()), "is not valid JSON");
+                }
+                return true;
+            });
+            if (!item_ok)
+                return field.empty() ? fail("bookings[" + std::to_string(out.size() - 1) + "]", "must be an object")
+                                     : false;
+            skip_ws(body, i);
+            if (i < body.size() && body[i] == ',') { ++i; skip_ws(body, i); continue; }
+            if (i < body.size() && body[i] == ']') { ++i; return true; }
+            return fail("bookings", "is not valid JSON");
+        }
+    });
+    if (!ok) return field.empty() ? fail("", "body must be a JSON object") : false;
+    skip_ws(body, i);
+    if (i != body.size()) return fail("", "body must be a JSON object");
+    if (!have_bookings || out.empty()) return fail("bookings", "is required");
+    if (group_name.size() > 200) return fail("name", "is too long");
+
+    for (size_t n = 0; n < out.size(); ++n) {
+        BookingRequest &b = out[n];
+        std::string at = "bookings[" + std::to_string(n) + "].";
+        if (!named[n]) b.name = group_name;
+        int from = 0, to = 0;
+        if (b.room_id < 1) return fail(at + "room_id", "is required");
+        if (b.name.empty()) return fail(at + "name", "is required");
+        if (b.name.size() > 200) return fail(at + "name", "is too long");
+        if (!parse_date(b.check_in, from)) return fail(at + "check_in", "must be a date (YYYY-MM-DD)");
+        if (!parse_date(b.check_out, to)) return fail(at + "check_out", "must be a date (YYYY-MM-DD)");
+        if (to <= from) return fail(at + "check_out", "must be after check_in");
+    }
+    return true;
+}
+
+// Body of POST /cancel/batch, one of
+//   {"booking_ids": [17, 18, 42]}
+//   {"room_id": 101, "from": "2026-12-24", "to": "2026-12-27"}
+// The second form cancels the active bookings with a night in [from, to).
+// Either date may be left out for one room; without room_id it covers every
+// room, and then both dates are required.
+inline bool parse_cancel_batch(const std::string &body, size_t max_items, CancelSelection &out,
+                               std::string &field, const char *&reason) {
+    using namespace booking_batch_detail;
+    out = CancelSelection();
+    field.clear();
+    size_t i = 0;
+    auto fail = [&](std::string f, const char *why) {
+        field = std::move(f);
+        reason = why;
+        return false;
+    };
+    bool have_ids = false;
+    bool ok = read_object(body, i, [&](const std::string &key) {
+        if (key == "room_id") {
+            if (!read_int(body, i, out.room_id) || out.room_id < 1)
+                return fail("room_id", "must be a positive integer");
+        } else if (key == "from" || key == "to") {
+            if (!read_string(body, i, key == "from" ? out.from : out.to)) return fail(key, "must be a string");
+        } else if (key == "booking_ids") {
+            have_ids = true;
+            if (i >= body.size() || body[i] != '[') return fail("booking_ids", "must be an array");
+            ++i;
+            skip_ws(body, i);
+            if (i < body.size() && body[i] == ']') { ++i; return true; }
+            for (;;) {
+                if (out.booking_ids.size() == max_items) return fail("booking_ids", "has too many entries");
+                int id = 0;
+                if (!read_int(body, i, id) || id < 1) return fail("booking_ids", "must hold positive integers");
+                out.booking_ids.push_back(id);
+                skip_ws(body, i);
+                if (i < body.size() && body[i] == ',') { ++i; continue; }
+                if (i < body.size() && body[i] == ']') { ++i; return true; }
+                return fail("booking_ids", "is not valid JSON");
+            }
+        } else if (!skip_value(body, i)) {
+            return fail(key, "is not valid JSON");
+        }
+        return true;
+    });
+    if (!ok) return field.empty() ? fail("", "body must be a JSON object") : false;
+    skip_ws(body, i);
+    if (i != body.size()) return fail("", "body must be a JSON object");
+
+    bool by_range = out.room_id || !out.from.empty() || !out.to.empty();
+    if (have_ids && by_range) return fail("booking_ids", "cannot be combined with room_id/from/to");
+    if (have_ids && out.booking_ids.empty()) return fail("booking_ids", "is empty");
+    if (!have_ids && !by_range) return fail("booking_ids", "is required");
+    int from = 0, to = 0;
+    if (!out.from.empty() && !parse_date(out.from, from)) return fail("from", "must be a date (YYYY-MM-DD)");
+    if (!out.to.empty() && !parse_date(out.to, to)) return fail("to", "must be a date (YYYY-MM-DD)");
+    if (!out.from.empty() && !out.to.empty() && to <= from) return fail("to", "must be after from");
+    if (by_range && !out.room_id && (out.from.empty() || out.to.empty()))
+        return fail(out.from.empty() ? "from" : "to", "is required when room_id is not given");
+    return true;
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Dates are handled as day numbers (days since 1970-01-01) so ranges can be
+// compared with plain integer arithmetic.
+inline int days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const int yoe = y - era * 400;
+    const int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// Parses a strict YYYY-MM-DD date. Returns false on anything else,
+// including impossible dates such as 2025-02-30.
+inline bool parse_date(const std::string &s, int &day) {
+    if (s.size() != 10 || s[4] != '-' || s[7] != '-') return false;
+    int v[3] = {0, 0, 0};
+    const int start[3] = {0, 5, 8}, len[3] = {4, 2, 2};
+    for (int f = 0; f < 3; ++f) {
+        for (int i = start[f]; i < start[f] + len[f]; ++i) {
+            if (s[i] < '0' || s[i] > '9') return false;
+            v[f] = v[f] * 10 + (s[i] - '0');
+        }
+    }
+    int y = v[0], m = v[1], d = v[2];
+    if (m < 1 || m > 12 || d < 1) return false;
+    static const int mdays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    if (d > mdays[m - 1] + (m == 2 && leap)) return false;
+    day = days_from_civil(y, m, d);
+    return true;
+}
+
+// Inverse of days_from_civil, formatted as YYYY-MM-DD.
+inline std::string format_date(int day) {
+    day += 719468;
+    const int era = (day >= 0 ? day : day - 146096) / 146097;
+    const int doe = day - era * 146097;
+    const int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int mp = (5 * doy + 2) / 153;
+    const int d = doy - (153 * mp + 2) / 5 + 1;
+    const int m = mp + (mp < 10 ? 3 : -9);
+    const int y = yoe + era * 400 + (m <= 2);
+    char buf[32];
+    std::snprintf(buf, sizeof buf, "%04d-%02d-%02d", y, m, d);
+    return buf;
+}
+
+// Today's day number in UTC.
+inline int today_day() {
+    using namespace std::chrono;
+    return (int) duration_cast<hours>(system_clock::now().time_since_epoch()).count() / 24;
+}
+
+// Active bookings per room as half-open night ranges [from, to). Ranges in
+// one room never overlap (bookRoom refuses them), so each room keeps them
+// in a vector sorted by start night and an overlap check is one binary
+// search: O(log n), no SQL round trip, and cache-friendly enough to scan
+// tens of thousands of rooms per query.
+class BookingIndex {
+public:
+    void clear() {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        rooms.clear();
+        by_id.clear();
+    }
+
+    // Returns false (and records nothing) if the range clashes with an
+    // existing booking of the same room.
+    bool add(int booking_id, int room_id, int from, int to) {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        if (overlapsLocked(room_id, from, to)) return false;
+        auto &v = rooms[room_id];
+        v.insert(std::lower_bound(v.begin(), v.end(), from, startsBefore), Span{from, to, booking_id});
+        by_id[booking_id] = Loc{room_id, from};
+        return true;
+    }
+
+    struct Range { int room_id; int from; int to; };
+
+    // Drops a booking; if out is given it receives the range it held.
+    bool remove(int booking_id, Range *out = nullptr) {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        auto it = by_id.find(booking_id);
+        if (it == by_id.end()) return false;
+        auto r = rooms.find(it->second.room_id);
+        if (r != rooms.end()) {
+            auto &v = r->second;
+            auto s = std::lower_bound(v.begin(), v.end(), it->second.from, startsBefore);
+            if (s != v.end() && s->booking_id == booking_id) {
+                if (out) *out = Range{it->second.room_id, s->from, s->to};
+                v.erase(s);
+            }
+            if (v.empty()) rooms.erase(r);
+        }
+        by_id.erase(it);
+        return true;
+    }
+
+    // Calls f(room_id, from, to) for every active booking.
+    template <class F>
+    void forEach(F f) const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        for (const auto &r : rooms)
+            for (const auto &s : r.second) f(r.first, s.from, s.to);
+    }
+
+    bool overlaps(int room_id, int from, int to) const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        return overlapsLocked(room_id, from, to);
+    }
+
+    bool occupied(int room_id, int day) const { return overlaps(room_id, day, day + 1); }
+
+    // Calls out(room) for every room in [first, last) that is free for all
+    // nights in [from, to). Takes the read lock once for the whole scan.
+    template <class It, class Out>
+    void forEachFree(It first, It last, int from, int to, Out out) const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        for (; first != last; ++first)
+            if (!overlapsLocked(first->room_id, from, to)) out(*first);
+    }
+
+private:
+    struct Span { int from; int to; int booking_id; };
+    struct Loc { int room_id; int from; };
+
+    static bool startsBefore(const Span &s, int day) { return s.from < day; }
+
+    bool overlapsLocked(int room_id, int from, int to) const {
+        auto r = rooms.find(room_id);
+        if (r == rooms.end()) return false;
+        const auto &v = r->second;
+        auto it = std::lower_bound(v.begin(), v.end(), from, startsBefore);
+        if (it != v.end() && it->from < to) return true;
+        if (it != v.begin() && std::prev(it)->to > from) return true;
+        return false;
+    }
+
+    mutable std::shared_mutex mtx;
+    std::unordered_map<int, std::vector<Span>> rooms;
+    std::unordered_map<int, Loc> by_id;
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+inline int popcount64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int) ((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// Occupancy bitmap: one bit per room per night for a fixed window of
+// nights starting at baseDay(). Each night is a contiguous row of 64-bit
+// words, so "how many rooms of type X are free tonight" is an and-not plus
+// popcount over one row (the loop is branch-free and the compiler can
+// vectorize it where the target has a vector popcount).
+class AvailabilityCalendar {
+public:
+    // Room slots in catalog order; every room listed starts free.
+    void reset(const std::vector<std::pair<int, std::string>> &rooms, int base_day, int nights) {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        base = base_day;
+        days = nights;
+        words = (rooms.size() + 63) / 64;
+        slot.clear();
+        masks.clear();
+        all_mask.assign(words, 0);
+        for (size_t i = 0; i < rooms.size(); ++i) {
+            slot[rooms[i].first] = (int) i;
+            auto &m = masks[rooms[i].second];
+            if (m.empty()) m.assign(words, 0);
+            m[i / 64] |= 1ULL << (i % 64);
+            all_mask[i / 64] |= 1ULL << (i % 64);
+        }
+        occupied.assign(words * days, 0);
+    }
+
+    // Sets or clears the nights [from, to) of a room, clipped to the window.
+    // Rooms not in the calendar (out of service) are ignored.
+    void mark(int room_id, int from, int to, bool booked) {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        auto it = slot.find(room_id);
+        if (it == slot.end()) return;
+        size_t w = it->second / 64;
+        uint64_t bit = 1ULL << (it->second % 64);
+        int lo = std::max(from, base) - base;
+        int hi = std::min(to, base + days) - base;
+        for (int d = lo; d < hi; ++d) {
+            uint64_t &word = occupied[d * words + w];
+            word = booked ? (word | bit) : (word & ~bit);
+        }
+    }
+
+    // Free rooms of `type` ("" = every room) for each of `nights` nights
+    // starting at `from`. Returns false if the range leaves the window;
+    // total receives the number of rooms of that type.
+    bool freeCounts(const std::string &type, int from, int nights,
+                    std::vector<int> &out, int &total) const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        out.clear();
+        total = 0;
+        if (from < base || nights < 0 || from + nights > base + days) return false;
+        const uint64_t *mask = all_mask.data();
+        if (!type.empty()) {
+            auto m = masks.find(type);
+            if (m == masks.end()) {
+                out.assign(nights, 0);
+                return true;
+            }
+            mask = m->second.data();
+        }
+        for (size_t w = 0; w < words; ++w) total += popcount64(mask[w]);
+        out.reserve(nights);
+        for (int d = from - base; d < from - base + nights; ++d) {
+            const uint64_t *row = &occupied[d * words];
+            int busy = 0;
+            for (size_t w = 0; w < words; ++w) busy += popcount64(mask[w] & row[w]);
+            out.push_back(total - busy);
+        }
+        return true;
+    }
+
+    // Whether the room is in the calendar, i.e. in service.
+    bool has(int room_id) const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        return slot.count(room_id) != 0;
+    }
+
+    int baseDay() const {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        return base;
+    }
+
+private:
+    mutable std::shared_mutex mtx;
+    int base = 0;
+    int days = 0;
+    size_t words = 0;
+    std::unordered_map<int, int> slot;                         // room_id -> bit
+    std::unordered_map<std::string, std::vector<uint64_t>> masks; // type -> rooms of that type
+    std::vector<uint64_t> all_mask;
+    std::vector<uint64_t> occupied;                            // days rows of `words` words
+};
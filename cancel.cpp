@@ -1,25 +1,14 @@
 // cancel.cpp
-// Compile: g++ cancel.cpp -o cancel.exe -lsqlite3
+// Cancels a booking, which frees its room for the booking's nights. Rooms
+// are not touched: rooms.is_available only says whether a room is in
+// service.
+// Compile: g++ -std=c++17 cancel.cpp -o cancel.exe -lsqlite3
 
 #include <iostream>
 #include <string>
 #include <sqlite3.h>
 #include <cstdlib>
-
-static std::string url_decode(const std::string &s){
-    std::string out; out.reserve(s.size());
-    for (size_t i=0;i<s.size();++i){
-        char c = s[i];
-        if (c=='+') out.push_back(' ');
-        else if (c=='%' && i+2 < s.size()){
-            std::string h = s.substr(i+1,2);
-            char ch = (char) strtol(h.c_str(), nullptr, 16);
-            out.push_back(ch);
-            i += 2;
-        } else out.push_back(c);
-    }
-    return out;
-}
+#include "form_parser.h"
 
 static std::string html_escape(const std::string &s){
     std::string o;
@@ -69,16 +58,10 @@ int main(){
     // POST
     std::string body = get_post_body();
     std::string booking_id_s;
-    size_t pos = 0;
-    while (pos < body.size()){
-        size_t eq = body.find('=', pos);
-        if (eq == std::string::npos) break;
-        std::string key = body.substr(pos, eq-pos);
-        size_t amp = body.find('&', eq+1);
-        std::string val = (amp==std::string::npos) ? body.substr(eq+1) : body.substr(eq+1, amp-(eq+1));
-        if (key=="booking_id") booking_id_s = url_decode(val);
-        if (amp==std::string::npos) break;
-        pos = amp+1;
+    FormView form;
+    if (!form.parse(body) || form.get("booking_id", booking_id_s) == FormView::Found::Malformed){
+        std::cout << "<h2>Malformed form data.</h2><p><a href='/cgi-bin/cancel.exe'>Back</a></p>";
+        return 0;
     }
 
     if (booking_id_s.empty()){
@@ -94,7 +77,7 @@ int main(){
     }
 
     // find booking and status
-    const char *q = "SELECT room_id, status FROM bookings WHERE booking_id = ?;";
+    const char *q = "SELECT room_id, status, check_in, check_out FROM bookings WHERE booking_id = ?;";
     sqlite3_stmt *stmt = nullptr;
     if (sqlite3_prepare_v2(db, q, -1, &stmt, nullptr) != SQLITE_OK){
         std::cout << "<h2>DB error</h2>";
@@ -112,6 +95,10 @@ int main(){
     int room_id = sqlite3_column_int(stmt, 0);
     const unsigned char *st = sqlite3_column_text(stmt, 1);
     std::string status = st ? reinterpret_cast<const char*>(st) : "";
+    const unsigned char *ci = sqlite3_column_text(stmt, 2);
+    const unsigned char *co = sqlite3_column_text(stmt, 3);
+    std::string check_in = ci ? reinterpret_cast<const char*>(ci) : "";
+    std::string check_out = co ? reinterpret_cast<const char*>(co) : "";
     sqlite3_finalize(stmt);
 
     if (status == "cancelled"){
@@ -120,33 +107,28 @@ int main(){
         return 0;
     }
 
-    // transaction: update booking to cancelled and mark room available
-    sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
-
-    const char *upd1 = "UPDATE bookings SET status='cancelled' WHERE booking_id = ?;";
-    sqlite3_stmt *u1 = nullptr;
-    if (sqlite3_prepare_v2(db, upd1, -1, &u1, nullptr) == SQLITE_OK){
-        sqlite3_bind_int(u1, 1, booking_id);
-        sqlite3_step(u1);
-        sqlite3_finalize(u1);
-    }
-
-    const char *upd2 = "UPDATE rooms SET is_available = 1 WHERE room_id = ?;";
-    sqlite3_stmt *u2 = nullptr;
-    if (sqlite3_prepare_v2(db, upd2, -1, &u2, nullptr) == SQLITE_OK){
-        sqlite3_bind_int(u2, 1, room_id);
-        sqlite3_step(u2);
-        sqlite3_finalize(u2);
+    // one statement, so a cancel racing this one cannot both succeed
+    sqlite3_busy_timeout(db, 5000);
+    const char *upd = "UPDATE bookings SET status='cancelled' WHERE booking_id = ? AND status = 'active';";
+    sqlite3_stmt *u = nullptr;
+    bool done = false;
+    if (sqlite3_prepare_v2(db, upd, -1, &u, nullptr) == SQLITE_OK){
+        sqlite3_bind_int(u, 1, booking_id);
+        done = sqlite3_step(u) == SQLITE_DONE && sqlite3_changes(db) == 1;
+        sqlite3_finalize(u);
     }
-
-    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
     sqlite3_close(db);
+    if (!done){
+        std::cout << "<h2>Booking could not be cancelled (already cancelled?)</h2><p><a href='/cgi-bin/rooms.exe'>View Rooms</a></p>";
+        return 0;
+    }
 
     std::cout << "<!doctype html><html><head><meta charset='utf-8'><title>Cancelled</title>"
               << "<link rel='stylesheet' href='/styles.css'></head><body>"
               << "<div class='card'><h2>Booking Cancelled</h2>"
               << "<p>Booking ID: <strong>" << booking_id << "</strong></p>"
-              << "<p>Room: <strong>" << room_id << "</strong> is now available.</p>"
+              << "<p>Room: <strong>" << room_id << "</strong> is free again from "
+              << html_escape(check_in) << " to " << html_escape(check_out) << ".</p>"
               << "<a class='btn' href='/cgi-bin/rooms.exe'>View Rooms</a> "
               << "<a class='btn outline' href='/index.html'>Home</a>"
               << "</div></body></html>";
@@ -0,0 +1,79 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <zlib.h>
+
+// Reusable gzip encoder. Setting up a deflate stream costs more than
+// compressing a few KB, so a long-lived encoder (one per thread) is reset
+// between bodies instead of re-initialized.
+class GzipEncoder {
+public:
+    explicit GzipEncoder(int level) {
+        // 15 window bits + 16 = gzip header and trailer instead of zlib's
+        ok_ = deflateInit2(&zs_, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~GzipEncoder() {
+        if (ok_) deflateEnd(&zs_);
+    }
+    GzipEncoder(const GzipEncoder &) = delete;
+    GzipEncoder &operator=(const GzipEncoder &) = delete;
+
+    // Compresses `in` into out (replacing its contents).
+    bool encode(std::string_view in, std::string &out) {
+        if (!ok_ || deflateReset(&zs_) != Z_OK) return false;
+        out.resize(deflateBound(&zs_, (uLong) in.size()));
+        zs_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+        zs_.avail_in = (uInt) in.size();
+        zs_.next_out = reinterpret_cast<Bytef *>(&out[0]);
+        zs_.avail_out = (uInt) out.size();
+        int rc = deflate(&zs_, Z_FINISH);
+        out.resize(zs_.total_out);
+        return rc == Z_STREAM_END;
+    }
+
+private:
+    z_stream zs_{};
+    bool ok_ = false;
+};
+
+// One-off gzip of `in`. Level 9 is for content compressed once and
+// served many times.
+inline bool gzip_compress(std::string_view in, std::string &out, int level = 9) {
+    GzipEncoder enc(level);
+    return enc.encode(in, out);
+}
+
+// Whether an Accept-Encoding header allows `coding` ("gzip"): listed by
+// name or via *, and not with q=0.
+inline bool accepts_encoding(std::string_view header, std::string_view coding) {
+    auto trim = [](std::string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+        return s;
+    };
+    auto iequals = [](std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); ++i)
+            if ((a[i] | 0x20) != (b[i] | 0x20)) return false;
+        return true;
+    };
+    bool star = false;
+    while (!header.empty()) {
+        size_t comma = header.find(',');
+        std::string_view item = header.substr(0, comma);
+        header = comma == std::string_view::npos ? std::string_view() : header.substr(comma + 1);
+        size_t semi = item.find(';');
+        std::string_view name = trim(item.substr(0, semi));
+        bool zero = false;
+        if (semi != std::string_view::npos) {
+            std::string_view q = trim(item.substr(semi + 1));
+            if (q.size() >= 2 && (q[0] | 0x20) == 'q' && q[1] == '=') {
+                q = q.substr(2);
+                zero = q.find_first_not_of("0.") == std::string_view::npos;
+            }
+        }
+        if (iequals(name, coding)) return !zero;
+        if (name == "*") star = !zero;
+    }
+    return star;
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <charconv>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include "access_log.h"
+#include "admission.h"
+#include "database.h"
+#include "events.h"
+#include "trace.h"
+
+// Runtime settings of the server. Each one can be set in a config file as
+//   key = value        (one per line, # starts a comment)
+// or on the command line as --key=value, which wins over the file. The
+// file is --config=PATH, or server.conf in the working directory if that
+// exists. 0 for workers or db_connections means "pick from the core count".
+struct ServerConfig {
+    std::string host = "0.0.0.0";
+    int port = 18080;
+    std::string db_file = "hotel.db";
+    std::string seed_file = "seed.sql";
+    std::string static_dir = ".";   // UI files served from memory; "" = API only
+    int static_reload_ms = 1000;    // how often to look for changed UI files; 0 = never
+
+    int workers = 0;                // HTTP worker threads
+    int max_queued = 0;             // connections waiting for a worker before new ones are refused; 0 = no limit
+    int keep_alive_max_count = 100; // requests per keep-alive connection
+    int keep_alive_timeout = 5;     // seconds an idle keep-alive connection is held
+    int read_timeout = 5;           // seconds
+    int write_timeout = 5;          // seconds
+    int db_connections = 0;         // SQLite pool; 0 = one per worker
+    int compress_min_bytes = 1024;  // smaller API responses go out uncompressed
+    int compress_level = 1;         // gzip level for API responses; 0 = never compress
+    int batch_max_items = 500;      // entries accepted by one /book/batch or /cancel/batch request
+
+    WriterOptions writer;
+    TraceOptions trace;
+    AccessLogOptions access_log;
+    AdmissionOptions admission;
+    EventOptions events;
+};
+
+namespace config_detail {
+template <class T>
+inline bool number(std::string_view v, T &out, T min) {
+    T n{};
+    auto r = std::from_chars(v.data(), v.data() + v.size(), n);
+    if (r.ec != std::errc() || r.ptr != v.data() + v.size() || n < min) return false;
+    out = n;
+    return true;
+}
+
+inline std::string_view trim(std::string_view s) {
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string_view::npos) return {};
+    return s.substr(b, s.find_last_not_of(" \t\r") - b + 1);
+}
+}
+
+// Applies one setting; err says what is wrong with it.
+inline bool config_set(ServerConfig &c, std::string_view key, std::string_view v, std::string &err) {
+    using config_detail::number;
+    bool ok = true;
+    long long us = 0;
+    if (key == "host") c.host = std::string(v);
+    else if (key == "port") ok = number(v, c.port, 1) && c.port <= 65535;
+    else if (key == "db_file") c.db_file = std::string(v);
+    else if (key == "seed_file") c.seed_file = std::string(v);
+    else if (key == "static_dir") c.static_dir = std::string(v);
+    else if (key == "static_reload_ms") ok = number(v, c.static_reload_ms, 0);
+    else if (key == "workers") ok = number(v, c.workers, 0);
+    else if (key == "max_queued") ok = number(v, c.max_queued, 0);
+    else if (key == "keep_alive_max_count") ok = number(v, c.keep_alive_max_count, 1);
+    else if (key == "keep_alive_timeout") ok = number(v, c.keep_alive_timeout, 0);
+    else if (key == "read_timeout") ok = number(v, c.read_timeout, 1);
+    else if (key == "write_timeout") ok = number(v, c.write_timeout, 1);
+    else if (key == "compress_min_bytes") ok = number(v, c.compress_min_bytes, 0);
+    else if (key == "compress_level") ok = number(v, c.compress_level, 0) && c.compress_level <= 9;
+    else if (key == "batch_max_items") ok = number(v, c.batch_max_items, 1);
+    else if (key == "db_connections") ok = number(v, c.db_connections, 0);
+    else if (key == "write_batch") ok = number(v, c.writer.max_batch, (size_t) 1);
+    else if (key == "write_delay_us") {
+        ok = number(v, us, 0LL);
+        if (ok) c.writer.max_delay = std::chrono::microseconds(us);
+    }
+    else if (key == "change_log") ok = number(v, c.writer.change_log, (size_t) 1);
+    else if (key == "write_queue") ok = number(v, c.writer.queue_capacity, (size_t) 1);
+    else if (key == "trace_sample_every") ok = number(v, c.trace.sample_every, 0u);
+    else if (key == "trace_file") c.trace.file = std::string(v);
+    else if (key == "server_timing") {
+        ok = v == "0" || v == "1";
+        if (ok) c.trace.server_timing = v == "1";
+    }
+    else if (key == "rate_limit") ok = number(v, c.admission.rate, 0.0);
+    else if (key == "rate_burst") ok = number(v, c.admission.burst, 1.0);
+    else if (key == "inflight_rooms") ok = number(v, c.admission.max_inflight[HttpMetrics::Rooms], -1);
+    else if (key == "inflight_book") ok = number(v, c.admission.max_inflight[HttpMetrics::Book], -1);
+    else if (key == "inflight_cancel") ok = number(v, c.admission.max_inflight[HttpMetrics::Cancel], -1);
+    else if (key == "inflight_other") ok = number(v, c.admission.max_inflight[HttpMetrics::Other], -1);
+    else if (key == "trust_forwarded_for") {
+        ok = v == "0" || v == "1";
+        if (ok) c.admission.trust_forwarded_for = v == "1";
+    }
+    else if (key == "events_port") ok = number(v, c.events.port, 0) && c.events.port <= 65535;
+    else if (key == "events_max_subscribers") ok = number(v, c.events.max_subscribers, 1);
+    else if (key == "events_backlog") ok = number(v, c.events.backlog, (size_t) 1);
+    else if (key == "events_heartbeat_s") {
+        long long s = 0;
+        ok = number(v, s, 1LL);
+        if (ok) c.events.heartbeat = std::chrono::seconds(s);
+    }
+    else if (key == "access_log") c.access_log.file = std::string(v);
+    else if (key == "access_log_max_bytes") ok = number(v, c.access_log.max_file_bytes, (size_t) 1);
+    else if (key == "access_log_keep") ok = number(v, c.access_log.keep_files, 0);
+    else {
+        err = "unknown setting '" + std::string(key) + "'";
+        return false;
+    }
+    if (!ok) err = "bad value '" + std::string(v) + "' for " + std::string(key);
+    return ok;
+}
+
+inline bool config_load_file(ServerConfig &c, const std::string &path, std::string &err) {
+    std::ifstream in(path);
+    if (!in) {
+        err = "cannot read " + path;
+        return false;
+    }
+    std::string line;
+    for (int n = 1; std::getline(in, line); ++n) {
+        std::string_view s(line);
+        s = config_detail::trim(s.substr(0, s.find('#')));
+        if (s.empty()) continue;
+        size_t eq = s.find('=');
+        if (eq == std::string_view::npos) {
+            err = path + ":" + std::to_string(n) + ": expected key = value";
+            return false;
+        }
+        if (!config_set(c, config_detail::trim(s.substr(0, eq)), config_detail::trim(s.substr(eq + 1)), err)) {
+            err = path + ":" + std::to_string(n) + ": " + err;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads the config file, then applies the --key=value flags over it.
+inline bool config_load(ServerConfig &c, int argc, char **argv, std::string &err) {
+    std::string file = "server.conf";
+    bool explicit_file = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view a(argv[i]);
+        if (a.compare(0, 9, "--config=") == 0) {
+            file = std::string(a.substr(9));
+            explicit_file = true;
+        }
+    }
+    if (explicit_file || std::ifstream(file)) {
+        if (!config_load_file(c, file, err)) return false;
+    }
+    for (int i = 1; i < argc; ++i) {
+        std::string_view a(argv[i]);
+        size_t eq = a.find('=');
+        if (a.compare(0, 2, "--") != 0 || eq == std::string_view::npos) {
+            err = "expected --key=value, got '" + std::string(a) + "'";
+            return false;
+        }
+        std::string_view key = a.substr(2, eq - 2);
+        if (key == "config") continue;
+        if (!config_set(c, key, a.substr(eq + 1), err)) return false;
+    }
+    return true;
+}
@@ -1,147 +1,1145 @@
 #include "database.h"
+#include "import_reader.h"
 #include <sqlite3.h>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <climits>
+#include <iterator>
+#include <thread>
+
+// The calendar holds two years of nights and is rebuilt once today is a
+// year past its first night, so it always reaches at least 366 days ahead.
+static const int kCalendarNights = 2 * 366;
+static const int kCalendarRebase = 366;
+
+// Schema history. Each step runs once, in its own transaction, and is
+// recorded in schema_version; never edit a step that has shipped, append a
+// new one instead.
+struct Migration {
+    int version;
+    const char *sql;
+};
+
+static bool exec(sqlite3 *db, const char *sql);
+
+// Also run on every open: bulkImport drops these while it loads, and an
+// import that dies before rebuilding them must not leave them missing.
+static const char *const kBookingIndexes =
+    "CREATE INDEX IF NOT EXISTS idx_bookings_room_status ON bookings(room_id, status);"
+    "CREATE INDEX IF NOT EXISTS idx_bookings_dates ON bookings(check_in, check_out);"
+    "CREATE INDEX IF NOT EXISTS idx_bookings_phone ON bookings(phone);";
+
+static const Migration kMigrations[] = {
+    {1,
+     "CREATE TABLE IF NOT EXISTS rooms ("
+     "    room_id INTEGER PRIMARY KEY,"
+     "    type TEXT NOT NULL,"
+     "    price INTEGER NOT NULL,"
+     "    is_available INTEGER NOT NULL DEFAULT 1"
+     ");"
+     "CREATE TABLE IF NOT EXISTS bookings ("
+     "    booking_id INTEGER PRIMARY KEY AUTOINCREMENT,"
+     "    customer_name TEXT NOT NULL,"
+     "    phone TEXT,"
+     "    room_id INTEGER NOT NULL,"
+     "    check_in TEXT,"
+     "    check_out TEXT,"
+     "    status TEXT NOT NULL DEFAULT 'active',"
+     "    created_at TEXT DEFAULT (datetime('now')),"
+     "    FOREIGN KEY(room_id) REFERENCES rooms(room_id)"
+     ");"},
+    // is_available used to be cleared by every booking; it now only marks
+    // rooms taken out of service, so give back rooms the old code locked.
+    {2,
+     "UPDATE rooms SET is_available = 1 WHERE room_id IN "
+     "(SELECT room_id FROM bookings WHERE status = 'active');"},
+    {3, kBookingIndexes},
+    // change: 'booked', 'cancelled' or 'reloaded' (bulk import, room_id 0)
+    {4,
+     "CREATE TABLE IF NOT EXISTS room_changes ("
+     "    version INTEGER NOT NULL,"
+     "    room_id INTEGER NOT NULL,"
+     "    booking_id INTEGER,"
+     "    change TEXT NOT NULL,"
+     "    changed_on TEXT NOT NULL"
+     ");"
+     "CREATE INDEX IF NOT EXISTS idx_room_changes_version ON room_changes(version);"},
+};
+
+// SQL text for each Stmt id, in enum order.
+static const char *const kStmtSql[] = {
+    "BEGIN IMMEDIATE;",
+    "COMMIT;",
+    "ROLLBACK;",
+    "SAVEPOINT cmd;",
+    "RELEASE cmd;",
+    "ROLLBACK TO cmd;",
+    "SELECT room_id, type, price, is_available FROM rooms ORDER BY room_id;",
+    "SELECT is_available FROM rooms WHERE room_id = ?;",
+    // inserts nothing if an active booking of the room overlaps [?3, ?4)
+    "INSERT INTO bookings (customer_name, room_id, check_in, check_out, status) "
+    "SELECT ?1, ?2, ?3, ?4, 'active' WHERE NOT EXISTS (SELECT 1 FROM bookings "
+    "WHERE room_id = ?2 AND status = 'active' AND check_in < ?4 AND check_out > ?3);",
+    "SELECT 1 FROM bookings WHERE booking_id = ?;",
+    "UPDATE bookings SET status = 'cancelled' WHERE booking_id = ? AND status = 'active';",
+    "SELECT booking_id, room_id, check_in, check_out FROM bookings WHERE status = 'active';",
+    "SELECT room_id, type, price, is_available FROM rooms WHERE room_id = ?;",
+    "INSERT INTO room_changes (version, room_id, booking_id, change, changed_on) VALUES (?, ?, ?, ?, ?);",
+    "DELETE FROM room_changes WHERE version <= ?;",
+    "SELECT version, room_id, changed_on FROM room_changes ORDER BY version DESC LIMIT ?;",
+    // ?1 is a JSON array of booking ids
+    "UPDATE bookings SET status = 'cancelled' WHERE booking_id IN (SELECT value FROM json_each(?1)) "
+    "AND status = 'active' RETURNING booking_id;",
+    "SELECT booking_id FROM bookings WHERE booking_id IN (SELECT value FROM json_each(?1));",
+    // bookings with a night in [?2, ?3)
+    "UPDATE bookings SET status = 'cancelled' WHERE room_id = ?1 AND status = 'active' "
+    "AND check_in < ?3 AND check_out > ?2 RETURNING booking_id;",
+    "UPDATE bookings SET status = 'cancelled' WHERE status = 'active' "
+    "AND check_in < ?2 AND check_out > ?1 RETURNING booking_id;",
+};
+static_assert(sizeof(kStmtSql) / sizeof(kStmtSql[0]) == static_cast<size_t>(Stmt::Count),
+              "kStmtSql must have one entry per Stmt");
+
+// Statements that are meant to read a whole table; everything else must be
+// answered through an index (see Database::fullScans).
+static bool scanExpected(Stmt id) {
+    // LoadChanges walks the version index backwards, which the plan also
+    // reports as a scan
+    return id == Stmt::GetRooms || id == Stmt::LoadActiveBookings || id == Stmt::LoadChanges;
+}
+
+namespace {
+// Resets a cached statement on scope exit so it never keeps a read
+// transaction open or holds on to bound text between calls.
+class StmtScope {
+public:
+    explicit StmtScope(sqlite3_stmt *s) : s_(s) {}
+    ~StmtScope() {
+        if (s_) {
+            sqlite3_reset(s_);
+            sqlite3_clear_bindings(s_);
+        }
+    }
+    StmtScope(const StmtScope &) = delete;
+    StmtScope &operator=(const StmtScope &) = delete;
+    sqlite3_stmt *get() const { return s_; }
+    explicit operator bool() const { return s_ != nullptr; }
+private:
+    sqlite3_stmt *s_;
+};
+}
+
+// Checks a connection out of the pool for the lifetime of the scope.
+class Database::Lease {
+public:
+    explicit Lease(Database &d) : d_(d), c_(d.acquire()) {}
+    ~Lease() { if (c_) d_.release(c_); }
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+    Conn &operator*() const { return *c_; }
+    explicit operator bool() const { return c_ != nullptr; }
+private:
+    Database &d_;
+    Conn *c_;
+};
 
 Database::~Database() {
     close();
 }
 
+void Database::closeConn(Conn &c) {
+    for (auto &s : c.stmts) {
+        if (s) {
+            sqlite3_finalize(s);
+            s = nullptr;
+        }
+    }
+    if (c.db) {
+        sqlite3_close(c.db);
+        c.db = nullptr;
+    }
+}
+
 void Database::close() {
-    if (db) {
-        sqlite3_close(db);
-        db = nullptr;
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx);
+            stopping = true;
+        }
+        queue_cv.notify_all();
+        writer.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool_mtx);
+        for (auto &c : conns) closeConn(*c);
+        conns.clear();
+        idle.clear();
     }
+    pool_cv.notify_all();
 }
 
-bool Database::open(const std::string &dbfile, const std::string &sql_init_file) {
-    if (sqlite3_open(dbfile.c_str(), &db) != SQLITE_OK) {
-        std::cerr << "Cannot open DB: " << sqlite3_errmsg(db) << std::endl;
-        close();
+bool Database::open(const std::string &dbfile, const std::string &seed_file, int pool_size,
+                    const WriterOptions &writer_options) {
+    if (pool_size <= 0) pool_size = std::max(1u, std::thread::hardware_concurrency());
+    // every connection to ":memory:" is its own database
+    if (dbfile == ":memory:") pool_size = 1;
+    writer_opts = writer_options;
+    if (writer_opts.max_batch == 0) writer_opts.max_batch = 1;
+    if (writer_opts.queue_capacity == 0) writer_opts.queue_capacity = 1;
+    if (writer_opts.change_log == 0) writer_opts.change_log = 1;
+    uint64_t last_logged = 0;
+
+    for (int i = 0; i < pool_size; ++i) {
+        auto c = std::make_unique<Conn>();
+        int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX;
+        if (sqlite3_open_v2(dbfile.c_str(), &c->db, flags, nullptr) != SQLITE_OK) {
+            std::cerr << "Cannot open DB: " << sqlite3_errmsg(c->db) << std::endl;
+            closeConn(*c);
+            close();
+            return false;
+        }
+        sqlite3_busy_timeout(c->db, 5000);
+        // enable foreign keys
+        sqlite3_exec(c->db, "PRAGMA foreign_keys = ON;", nullptr, nullptr, nullptr);
+
+        if (i == 0) {
+            // WAL is persistent in the file, so setting it once is enough
+            sqlite3_exec(c->db, "PRAGMA journal_mode = WAL;", nullptr, nullptr, nullptr);
+            if (!migrate(*c, seed_file) || !exec(c->db, kBookingIndexes)) {
+                std::cerr << "Failed to migrate DB schema\n";
+                closeConn(*c);
+                close();
+                return false;
+            }
+        }
+        if (i == 0 && (!loadBookings(*c) || !loadCatalog(*c) || !loadChangeLog(*c, last_logged))) {
+            std::cerr << "Failed to load bookings\n";
+            closeConn(*c);
+            close();
+            return false;
+        }
+        if (i == 0) rebuildCalendar(today_day());
+        idle.push_back(c.get());
+        conns.push_back(std::move(c));
+    }
+
+    // start from the clock so versions (and ETags built from them) from a
+    // previous run of the server never come round again
+    uint64_t start = (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::system_clock::now().time_since_epoch()).count();
+    start = std::max(start, last_logged + 1);
+    catalog_version.store(start, std::memory_order_release);
+    {
+        std::unique_lock<std::shared_mutex> lock(change_mtx);
+        if (change_log.empty()) {
+            change_floor = start;
+            change_floor_day = today_day();
+        } else {
+            // the oldest version loaded may be missing some of its rows
+            change_floor = change_log.front().version;
+            change_floor_day = change_log.front().day;
+        }
+    }
+
+    stopping = false;
+    writer = std::thread(&Database::writerLoop, this);
+    return true;
+}
+
+// Rebuilds the in-memory index from the active rows of the bookings table.
+// Rows without a valid date range predate date-aware booking and are left
+// out, so they no longer block their room.
+bool Database::loadBookings(Conn &c) {
+    index.clear();
+    StmtScope stmt(prepared(c, Stmt::LoadActiveBookings));
+    if (!stmt) return false;
+    int rc;
+    while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+        const unsigned char *ci = sqlite3_column_text(stmt.get(), 2);
+        const unsigned char *co = sqlite3_column_text(stmt.get(), 3);
+        int from, to;
+        if (!ci || !co || !parse_date(reinterpret_cast<const char*>(ci), from) ||
+            !parse_date(reinterpret_cast<const char*>(co), to) || to <= from)
+            continue;
+        int booking_id = sqlite3_column_int(stmt.get(), 0);
+        int room_id = sqlite3_column_int(stmt.get(), 1);
+        if (!index.add(booking_id, room_id, from, to))
+            std::cerr << "Booking " << booking_id << " overlaps another booking of room "
+                      << room_id << ", ignoring it\n";
+    }
+    return rc == SQLITE_DONE;
+}
+
+static bool exec(sqlite3 *db, const char *sql) {
+    char *err = nullptr;
+    int rc = sqlite3_exec(db, sql, nullptr, nullptr, &err);
+    if (rc != SQLITE_OK) {
+        std::cerr << "SQL error: " << (err ? err : "unknown") << std::endl;
+        if (err) sqlite3_free(err);
         return false;
     }
-    // enable foreign keys
-    sqlite3_exec(db, "PRAGMA foreign_keys = ON;", nullptr, nullptr, nullptr);
+    return true;
+}
+
+// Runs a one-off query that yields a single integer; -1 on error.
+static int queryInt(sqlite3 *db, const char *sql) {
+    sqlite3_stmt *stmt = nullptr;
+    int v = -1;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW)
+        v = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    return v;
+}
+
+static int schemaVersion(sqlite3 *db) {
+    return queryInt(db, "SELECT COALESCE(MAX(version), 0) FROM schema_version;");
+}
 
-    if (!sql_init_file.empty()) {
-        if (!execSqlFile(sql_init_file)) {
-            std::cerr << "Failed to run init SQL file\n";
+// Brings the schema up to the last entry of kMigrations. An up-to-date DB
+// costs one query. seed_file is only run by the first migration, in the
+// same transaction, and only if that leaves the rooms table empty (a DB
+// that predates schema_version keeps its own rooms).
+bool Database::migrate(Conn &c, const std::string &seed_file) {
+    if (!exec(c.db, "CREATE TABLE IF NOT EXISTS schema_version ("
+                    "version INTEGER PRIMARY KEY, applied_at TEXT DEFAULT (datetime('now')));"))
+        return false;
+    const Migration &latest = kMigrations[sizeof(kMigrations) / sizeof(kMigrations[0]) - 1];
+    if (schemaVersion(c.db) >= latest.version) return true;
+
+    for (const Migration &m : kMigrations) {
+        // take the write lock first so two servers starting together
+        // cannot both apply the same step
+        if (!exec(c.db, "BEGIN IMMEDIATE;")) return false;
+        int current = schemaVersion(c.db);
+        if (current < 0) {
+            exec(c.db, "ROLLBACK;");
+            return false;
+        }
+        if (m.version <= current) {
+            exec(c.db, "COMMIT;");
+            continue;
+        }
+        bool ok = exec(c.db, m.sql);
+        if (ok && current == 0 && !seed_file.empty() &&
+            queryInt(c.db, "SELECT EXISTS (SELECT 1 FROM rooms);") == 0)
+            ok = execSqlFile(c, seed_file);
+        std::string mark = "INSERT INTO schema_version (version) VALUES (" +
+                           std::to_string(m.version) + ");";
+        if (!ok || !exec(c.db, mark.c_str()) || !exec(c.db, "COMMIT;")) {
+            exec(c.db, "ROLLBACK;");
+            std::cerr << "Migration " << m.version << " failed\n";
             return false;
         }
     }
     return true;
 }
 
-bool Database::execSqlFile(const std::string &sqlfile) {
+bool Database::execSqlFile(Conn &c, const std::string &sqlfile) {
     std::ifstream in(sqlfile);
-    if (!in) return false;
+    if (!in) {
+        std::cerr << "Cannot read " << sqlfile << std::endl;
+        return false;
+    }
     std::stringstream ss;
     ss << in.rdbuf();
-    std::string sql = ss.str();
+    return exec(c.db, ss.str().c_str());
+}
 
-    char *err = nullptr;
-    int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err);
-    if (rc != SQLITE_OK) {
-        std::cerr << "SQL error: " << (err ? err : "unknown") << std::endl;
-        if (err) sqlite3_free(err);
+// Blocks until a connection is idle. Returns nullptr if the pool is closed.
+Database::Conn *Database::acquire() {
+    std::unique_lock<std::mutex> lock(pool_mtx);
+    pool_cv.wait(lock, [this] { return !idle.empty() || conns.empty(); });
+    if (idle.empty()) return nullptr;
+    Conn *c = idle.back();
+    idle.pop_back();
+    return c;
+}
+
+void Database::release(Conn *c) {
+    {
+        std::lock_guard<std::mutex> lock(pool_mtx);
+        idle.push_back(c);
+    }
+    pool_cv.notify_one();
+}
+
+// Returns the cached statement for id, preparing it on first use.
+sqlite3_stmt *Database::prepared(Conn &c, Stmt id) {
+    sqlite3_stmt *&s = c.stmts[static_cast<int>(id)];
+    if (!s && c.db) {
+        if (sqlite3_prepare_v3(c.db, kStmtSql[static_cast<int>(id)], -1,
+                               SQLITE_PREPARE_PERSISTENT, &s, nullptr) != SQLITE_OK) {
+            std::cerr << "Prepare failed: " << sqlite3_errmsg(c.db) << std::endl;
+            s = nullptr;
+        }
+    }
+    return s;
+}
+
+// Steps a parameterless statement (BEGIN/COMMIT/ROLLBACK) to completion.
+bool Database::run(Conn &c, Stmt id) {
+    StmtScope s(prepared(c, id));
+    return s && sqlite3_step(s.get()) == SQLITE_DONE;
+}
+
+// Caches the in-service rooms for findAvailable. Rooms only change
+// through the init SQL and bulkImport's upserts, so this runs once per
+// open and again after each import.
+bool Database::loadCatalog(Conn &c) {
+    std::map<std::string, std::vector<Room>> next;
+    StmtScope stmt(prepared(c, Stmt::GetRooms));
+    if (!stmt) return false;
+    int rc;
+    while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+        if (!sqlite3_column_int(stmt.get(), 3)) continue;
+        Room r;
+        r.room_id = sqlite3_column_int(stmt.get(), 0);
+        const unsigned char *t = sqlite3_column_text(stmt.get(), 1);
+        r.type = t ? reinterpret_cast<const char*>(t) : "";
+        r.price = sqlite3_column_int(stmt.get(), 2);
+        next[r.type].push_back(r);
+    }
+    if (rc != SQLITE_DONE) return false;
+    for (auto &kv : next) {
+        std::sort(kv.second.begin(), kv.second.end(), [](const Room &a, const Room &b) {
+            return a.price != b.price ? a.price < b.price : a.room_id < b.room_id;
+        });
+    }
+    std::unique_lock<std::shared_mutex> lock(catalog_mtx);
+    catalog.swap(next);
+    return true;
+}
+
+// Lays out one calendar bit per catalog room and replays every active
+// booking into it.
+void Database::rebuildCalendar(int base_day) {
+    std::vector<std::pair<int, std::string>> slots;
+    {
+        std::shared_lock<std::shared_mutex> lock(catalog_mtx);
+        for (const auto &kv : catalog)
+            for (const auto &r : kv.second) slots.emplace_back(r.room_id, r.type);
+    }
+    calendar.reset(slots, base_day, kCalendarNights);
+    index.forEach([&](int room_id, int from, int to) { calendar.mark(room_id, from, to, true); });
+}
+
+bool Database::freeRoomCounts(const std::string &type, int from, int nights,
+                              std::vector<int> &out, int &total) {
+    int today = today_day();
+    if (today >= calendar.baseDay() + kCalendarRebase) {
+        // writers hold write_mtx across their index and calendar updates
+        std::lock_guard<std::mutex> writer(write_mtx);
+        if (today >= calendar.baseDay() + kCalendarRebase) rebuildCalendar(today);
+    }
+    return calendar.freeCounts(type, from, nights, out, total);
+}
+
+std::vector<Room> Database::findAvailable(const AvailabilityQuery &q) const {
+    std::vector<Room> out;
+    std::shared_lock<std::shared_mutex> lock(catalog_mtx);
+    auto scan = [&](const std::vector<Room> &rooms) {
+        auto last = rooms.end();
+        if (q.max_price >= 0) {
+            last = std::upper_bound(rooms.begin(), rooms.end(), q.max_price,
+                                    [](int p, const Room &r) { return p < r.price; });
+        }
+        index.forEachFree(rooms.begin(), last, q.from, q.to,
+                          [&](const Room &r) { out.push_back(r); });
+    };
+    if (q.type.empty()) {
+        for (const auto &kv : catalog) scan(kv.second);
+    } else {
+        auto it = catalog.find(q.type);
+        if (it != catalog.end()) scan(it->second);
+    }
+    return out;
+}
+
+namespace {
+// Statements prepared once for the duration of a bulk import.
+struct ImportStmts {
+    sqlite3_stmt *room = nullptr;
+    sqlite3_stmt *booking = nullptr;
+    ~ImportStmts() {
+        sqlite3_finalize(room);
+        sqlite3_finalize(booking);
+    }
+};
+
+void bindText(sqlite3_stmt *s, int idx, const ImportRow &row, int col) {
+    if (row.has[col]) sqlite3_bind_text(s, idx, row.col[col].data(), (int) row.col[col].size(), SQLITE_STATIC);
+    else sqlite3_bind_null(s, idx);
+}
+
+// Nights an imported active booking takes, [from, to) of room_id; to is 0
+// for rooms and cancelled bookings.
+struct ImportStay {
+    int room_id = 0, from = 0, to = 0;
+};
+
+// Binds one import row to its insert statement; err says why not.
+bool bindImportRow(const ImportStmts &st, const ImportRow &row, ImportStay &stay, std::string &err) {
+    long long v;
+    int day;
+    stay = ImportStay();
+    if (row.kind == ImportRow::Room) {
+        sqlite3_stmt *s = st.room;
+        if (!row.has[0] || !import_int(row.col[0], v)) { err = "bad room_id"; return false; }
+        sqlite3_bind_int64(s, 1, v);
+        if (!row.has[1]) { err = "missing type"; return false; }
+        bindText(s, 2, row, 1);
+        if (!row.has[2] || !import_int(row.col[2], v) || v < 0) { err = "bad price"; return false; }
+        sqlite3_bind_int64(s, 3, v);
+        v = 1;
+        if (row.has[3] && (!import_int(row.col[3], v) || (v != 0 && v != 1))) {
+            err = "bad is_available";
+            return false;
+        }
+        sqlite3_bind_int64(s, 4, v);
+        return true;
+    }
+    sqlite3_stmt *s = st.booking;
+    if (row.has[0]) {
+        if (!import_int(row.col[0], v) || v <= 0) { err = "bad booking_id"; return false; }
+        sqlite3_bind_int64(s, 1, v);
+    } else {
+        sqlite3_bind_null(s, 1);
+    }
+    if (!row.has[1]) { err = "missing customer_name"; return false; }
+    bindText(s, 2, row, 1);
+    bindText(s, 3, row, 2);
+    if (!row.has[3] || !import_int(row.col[3], v) || v <= 0 || v > INT_MAX) { err = "bad room_id"; return false; }
+    sqlite3_bind_int64(s, 4, v);
+    stay.room_id = (int) v;
+    if ((row.has[4] && !parse_date(row.col[4], stay.from)) || (row.has[5] && !parse_date(row.col[5], day))) {
+        err = "dates must be YYYY-MM-DD";
+        return false;
+    }
+    if (row.has[4] && row.has[5] && day <= stay.from) {
+        err = "check_out must be after check_in";
+        return false;
+    }
+    bindText(s, 5, row, 4);
+    bindText(s, 6, row, 5);
+    if (row.has[6] && row.col[6] != "active" && row.col[6] != "cancelled") {
+        err = "status must be active or cancelled";
+        return false;
+    }
+    if (row.has[6]) bindText(s, 7, row, 6);
+    else sqlite3_bind_text(s, 7, "active", -1, SQLITE_STATIC);
+    if (row.has[6] && row.col[6] == "cancelled") return true;
+    // the index only holds dated stays, so an undated active booking would
+    // sit in the table blocking nothing
+    if (!row.has[4] || !row.has[5]) {
+        err = "an active booking needs check_in and check_out";
         return false;
     }
+    stay.to = day;
+    return true;
+}
+}
+
+bool Database::bulkImport(const std::string &path, ImportStats &stats, long long chunk_rows) {
+    stats = ImportStats();
+    auto reject = [&stats](long long line_no, const std::string &why) {
+        if (stats.errors.size() < 20)
+            stats.errors.push_back("line " + std::to_string(line_no) + ": " + why);
+        ++stats.rejected;
+    };
+    bool jsonl = path.size() >= 6 && path.compare(path.size() - 6, 6, ".jsonl") == 0;
+
+    std::vector<char> iobuf(1 << 20);
+    std::ifstream in;
+    in.rdbuf()->pubsetbuf(iobuf.data(), (std::streamsize) iobuf.size());
+    in.open(path, std::ios::binary);
+    if (!in) {
+        stats.errors.push_back("cannot read " + path);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> writer_lock(write_mtx);
+    Lease conn(*this);
+    if (!conn) {
+        stats.errors.push_back("database not open");
+        return false;
+    }
+    sqlite3 *db = (*conn).db;
+
+    // Loading into indexed tables costs a B-tree update per row and index;
+    // drop the bookings indexes and rebuild each once at the end instead.
+    std::vector<std::string> index_sql;
+    {
+        sqlite3_stmt *q = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT name, sql FROM sqlite_master WHERE type = 'index' "
+                                   "AND tbl_name = 'bookings' AND sql IS NOT NULL;",
+                               -1, &q, nullptr) == SQLITE_OK) {
+            std::vector<std::string> names;
+            while (sqlite3_step(q) == SQLITE_ROW) {
+                names.push_back(reinterpret_cast<const char*>(sqlite3_column_text(q, 0)));
+                index_sql.push_back(reinterpret_cast<const char*>(sqlite3_column_text(q, 1)));
+            }
+            sqlite3_finalize(q);
+            for (const auto &n : names) exec(db, ("DROP INDEX IF EXISTS \"" + n + "\";").c_str());
+        }
+    }
+    int old_sync = queryInt(db, "PRAGMA synchronous;");
+    int old_cache = queryInt(db, "PRAGMA cache_size;");
+    exec(db, "PRAGMA synchronous = OFF;");
+    // a large page cache keeps the index rebuild sorts in memory
+    exec(db, "PRAGMA cache_size = -262144;");
+    exec(db, "PRAGMA temp_store = MEMORY;");
+
+    ImportStmts st;
+    bool ok =
+        sqlite3_prepare_v2(db, "INSERT INTO rooms (room_id, type, price, is_available) VALUES (?, ?, ?, ?) "
+                               "ON CONFLICT(room_id) DO UPDATE SET type = excluded.type, "
+                               "price = excluded.price, is_available = excluded.is_available;",
+                           -1, &st.room, nullptr) == SQLITE_OK &&
+        // created_at is bound once per import rather than calling the
+        // column default datetime('now') for every row
+        sqlite3_prepare_v2(db, "INSERT INTO bookings (booking_id, customer_name, phone, room_id, "
+                               "check_in, check_out, status, created_at) "
+                               "VALUES (?, ?, ?, ?, ?, ?, ?, ?);",
+                           -1, &st.booking, nullptr) == SQLITE_OK &&
+        exec(db, "BEGIN;");
+
+    std::string now;
+    {
+        sqlite3_stmt *q = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT datetime('now');", -1, &q, nullptr) == SQLITE_OK &&
+            sqlite3_step(q) == SQLITE_ROW)
+            now = reinterpret_cast<const char*>(sqlite3_column_text(q, 0));
+        sqlite3_finalize(q);
+    }
+    ImportRow row;
+    std::string line, err;
+    long long line_no = 0, in_chunk = 0;
+    while (ok && std::getline(in, line)) {
+        ++line_no;
+        if (line.empty() || line == "\r") continue;
+        bool parsed = jsonl ? parse_jsonl_row(line, row, err) : parse_csv_row(line, row, err);
+        if (!parsed) {
+            reject(line_no, err);
+            continue;
+        }
+        sqlite3_stmt *s = row.kind == ImportRow::Room ? st.room : st.booking;
+        if (row.kind == ImportRow::Booking)
+            sqlite3_bind_text(s, 8, now.data(), (int) now.size(), SQLITE_STATIC);
+        ImportStay stay;
+        if (!bindImportRow(st, row, stay, err)) {
+            reject(line_no, err);
+        } else if (stay.to && index.overlaps(stay.room_id, stay.from, stay.to)) {
+            // an active booking already holds one of these nights, from
+            // before the import or earlier in this file
+            reject(line_no, "overlaps an active booking of room " + std::to_string(stay.room_id));
+        } else if (sqlite3_step(s) != SQLITE_DONE) {
+            reject(line_no, sqlite3_errmsg(db));
+        } else {
+            if (stay.to) index.add((int) sqlite3_last_insert_rowid(db), stay.room_id, stay.from, stay.to);
+            ++(row.kind == ImportRow::Room ? stats.rooms : stats.bookings);
+            if (++in_chunk >= chunk_rows) {
+                ok = exec(db, "COMMIT;") && exec(db, "BEGIN;");
+                in_chunk = 0;
+            }
+        }
+        sqlite3_reset(s);
+        sqlite3_clear_bindings(s);
+    }
+    if (ok) ok = exec(db, "COMMIT;");
+    else exec(db, "ROLLBACK;");
+    if (!ok) stats.errors.push_back(std::string("load failed: ") + sqlite3_errmsg(db));
+
+    for (const auto &sql : index_sql) exec(db, sql.c_str());
+    exec(db, ("PRAGMA synchronous = " + std::to_string(old_sync < 0 ? 2 : old_sync) + ";").c_str());
+    exec(db, ("PRAGMA cache_size = " + std::to_string(old_cache) + ";").c_str());
+    exec(db, "PRAGMA temp_store = DEFAULT;");
+
+    // the import went around bookRoom, so rebuild what mirrors the tables
+    if (!loadBookings(*conn) || !loadCatalog(*conn)) {
+        stats.errors.push_back("failed to reload bookings after import");
+        ok = false;
+    }
+    rebuildCalendar(today_day());
+    RoomChange reload;
+    reload.kind = RoomChange::Reloaded;
+    logChange(*conn, catalogVersion() + 1, 0, 0, "reloaded");
+    reload.version = advance({0}, today_day());
+    if (on_change) on_change({reload});
+    return ok;
+}
+
+bool Database::loadChangeLog(Conn &c, uint64_t &last) {
+    StmtScope stmt(prepared(c, Stmt::LoadChanges));
+    if (!stmt) return false;
+    sqlite3_bind_int64(stmt.get(), 1, (sqlite3_int64) writer_opts.change_log);
+    std::deque<LoggedChange> loaded;
+    int rc;
+    while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+        LoggedChange ch;
+        ch.version = (uint64_t) sqlite3_column_int64(stmt.get(), 0);
+        ch.room_id = sqlite3_column_int(stmt.get(), 1);
+        const unsigned char *d = sqlite3_column_text(stmt.get(), 2);
+        if (!d || !parse_date(reinterpret_cast<const char*>(d), ch.day)) ch.day = 0;
+        loaded.push_front(ch);
+    }
+    if (rc != SQLITE_DONE) return false;
+    last = loaded.empty() ? 0 : loaded.back().version;
+    std::unique_lock<std::shared_mutex> lock(change_mtx);
+    change_log.swap(loaded);
+    // whatever is in the table beyond what was loaded goes at the next prune
+    change_rows = writer_opts.change_log;
+    return true;
+}
+
+// Adds a row to room_changes in the writer's open transaction (or on its
+// own for a bulk import).
+bool Database::logChange(Conn &c, uint64_t version, int room_id, int booking_id, const char *change) {
+    StmtScope ins(prepared(c, Stmt::InsertChange));
+    if (!ins) return false;
+    std::string day = format_date(today_day());
+    sqlite3_bind_int64(ins.get(), 1, (sqlite3_int64) version);
+    sqlite3_bind_int(ins.get(), 2, room_id);
+    if (booking_id > 0) sqlite3_bind_int(ins.get(), 3, booking_id);
+    sqlite3_bind_text(ins.get(), 4, change, -1, SQLITE_STATIC);
+    sqlite3_bind_text(ins.get(), 5, day.c_str(), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(ins.get()) != SQLITE_DONE) return false;
+    ++change_rows;
     return true;
 }
 
+// Moves catalog_version on by one and logs room_ids under the new version,
+// both under change_mtx, so changedRooms never hands out a version without
+// all of its entries. Returns the new version. Callers hold write_mtx.
+uint64_t Database::advance(const std::vector<int> &room_ids, int day) {
+    std::unique_lock<std::shared_mutex> lock(change_mtx);
+    uint64_t version = catalog_version.fetch_add(1, std::memory_order_acq_rel) + 1;
+    for (int room_id : room_ids) change_log.push_back(LoggedChange{version, room_id, day});
+    while (change_log.size() > writer_opts.change_log) {
+        change_floor = change_log.front().version;
+        change_floor_day = change_log.front().day;
+        change_log.pop_front();
+    }
+    return version;
+}
+
+// Starts a new version for a new day if nothing has been committed yet
+// today, so clients that sync today get a version they can resume from.
+void Database::markDay(int today) {
+    {
+        std::shared_lock<std::shared_mutex> lock(change_mtx);
+        int latest = change_log.empty() ? change_floor_day : change_log.back().day;
+        if (latest >= today) return;
+    }
+    std::lock_guard<std::mutex> writer_lock(write_mtx);
+    {
+        std::shared_lock<std::shared_mutex> lock(change_mtx);
+        int latest = change_log.empty() ? change_floor_day : change_log.back().day;
+        if (latest >= today) return;
+    }
+    advance({-1}, today);
+}
+
+bool Database::changedRooms(uint64_t since, std::vector<Room> &out, uint64_t &version) {
+    out.clear();
+    int today = today_day();
+    markDay(today);
+    std::vector<int> rooms;
+    {
+        std::shared_lock<std::shared_mutex> lock(change_mtx);
+        version = catalogVersion();
+        if (since < change_floor || since > version) return false;
+        // first entry after `since`; the one before it (or the floor) gives
+        // the day `since` was handed out on, or a later one
+        auto it = std::upper_bound(change_log.begin(), change_log.end(), since,
+                                   [](uint64_t v, const LoggedChange &c) { return v < c.version; });
+        int day = it == change_log.begin() ? change_floor_day : std::prev(it)->day;
+        if (day != today) return false;
+        for (; it != change_log.end(); ++it) {
+            if (it->room_id == 0) return false;
+            if (it->room_id > 0) rooms.push_back(it->room_id);
+        }
+    }
+    std::sort(rooms.begin(), rooms.end());
+    rooms.erase(std::unique(rooms.begin(), rooms.end()), rooms.end());
+    if (rooms.empty()) return true;
+
+    Lease conn(*this);
+    if (!conn) return false;
+    StmtScope stmt(prepared(*conn, Stmt::GetRoom));
+    if (!stmt) return false;
+    for (int id : rooms) {
+        sqlite3_reset(stmt.get());
+        sqlite3_bind_int(stmt.get(), 1, id);
+        if (sqlite3_step(stmt.get()) != SQLITE_ROW) continue;
+        Room r;
+        r.room_id = id;
+        const unsigned char *t = sqlite3_column_text(stmt.get(), 1);
+        r.type = t ? reinterpret_cast<const char*>(t) : "";
+        r.price = sqlite3_column_int(stmt.get(), 2);
+        r.is_available = sqlite3_column_int(stmt.get(), 3) && !index.occupied(id, today);
+        out.push_back(r);
+    }
+    return true;
+}
+
+void Database::setChangeListener(ChangeListener listener) {
+    std::lock_guard<std::mutex> lock(write_mtx);
+    on_change = std::move(listener);
+}
+
+std::vector<std::string> Database::fullScans() {
+    std::vector<std::string> out;
+    Lease conn(*this);
+    if (!conn) return out;
+    for (int i = 0; i < static_cast<int>(Stmt::Count); ++i) {
+        if (scanExpected(static_cast<Stmt>(i))) continue;
+        std::string q = std::string("EXPLAIN QUERY PLAN ") + kStmtSql[i];
+        sqlite3_stmt *plan = nullptr;
+        if (sqlite3_prepare_v2((*conn).db, q.c_str(), -1, &plan, nullptr) != SQLITE_OK) {
+            out.push_back(std::string(kStmtSql[i]) + " (cannot explain: " +
+                          sqlite3_errmsg((*conn).db) + ")");
+            continue;
+        }
+        while (sqlite3_step(plan) == SQLITE_ROW) {
+            const unsigned char *detail = sqlite3_column_text(plan, 3);
+            std::string d = detail ? reinterpret_cast<const char*>(detail) : "";
+            // walking a bound json_each list is the point of those statements
+            if (d.compare(0, 5, "SCAN ") == 0 && d != "SCAN CONSTANT ROW" &&
+                d.compare(0, 14, "SCAN json_each") != 0) {
+                out.push_back(std::string(kStmtSql[i]) + " -> " + d);
+                break;
+            }
+        }
+        sqlite3_finalize(plan);
+    }
+    return out;
+}
+
+DbStats Database::dbStats() {
+    static const int kOps[5] = {SQLITE_DBSTATUS_CACHE_USED, SQLITE_DBSTATUS_CACHE_HIT,
+                                SQLITE_DBSTATUS_CACHE_MISS, SQLITE_DBSTATUS_CACHE_WRITE,
+                                SQLITE_DBSTATUS_STMT_USED};
+    DbStats st;
+    sqlite3_int64 cur = 0, high = 0;
+    sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &cur, &high, 0);
+    st.memory_used = cur;
+    st.memory_highwater = high;
+    sqlite3_status64(SQLITE_STATUS_MALLOC_COUNT, &cur, &high, 0);
+    st.malloc_count = cur;
+    sqlite3_status64(SQLITE_STATUS_PAGECACHE_OVERFLOW, &cur, &high, 0);
+    st.pagecache_overflow = cur;
+    {
+        // connections are opened NOMUTEX, so only idle ones may be read;
+        // holding pool_mtx keeps them idle meanwhile
+        std::lock_guard<std::mutex> lock(pool_mtx);
+        st.connections = (int) conns.size();
+        st.idle_connections = (int) idle.size();
+        for (Conn *c : idle) {
+            for (int i = 0; i < 5; ++i) {
+                int v = 0, hw = 0;
+                if (sqlite3_db_status(c->db, kOps[i], &v, &hw, 0) == SQLITE_OK) c->status[i] = v;
+            }
+        }
+        for (auto &c : conns) {
+            st.cache_used += c->status[0];
+            st.cache_hit += c->status[1];
+            st.cache_miss += c->status[2];
+            st.cache_write += c->status[3];
+            st.stmt_used += c->status[4];
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx);
+        st.write_queue = queue.size();
+    }
+    return st;
+}
+
 std::vector<Room> Database::getRooms() {
     std::vector<Room> out;
-    const char *q = "SELECT room_id, type, price, is_available FROM rooms ORDER BY room_id;";
-    sqlite3_stmt *stmt = nullptr;
-    if (sqlite3_prepare_v2(db, q, -1, &stmt, nullptr) != SQLITE_OK) return out;
+    Lease conn(*this);
+    if (!conn) return out;
+    StmtScope stmt(prepared(*conn, Stmt::GetRooms));
+    if (!stmt) return out;
+    int today = today_day();
 
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
+    while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
         Room r;
-        r.room_id = sqlite3_column_int(stmt, 0);
-        const unsigned char *t = sqlite3_column_text(stmt, 1);
+        r.room_id = sqlite3_column_int(stmt.get(), 0);
+        const unsigned char *t = sqlite3_column_text(stmt.get(), 1);
         r.type = t ? reinterpret_cast<const char*>(t) : "";
-        r.price = sqlite3_column_int(stmt, 2);
-        r.is_available = sqlite3_column_int(stmt, 3);
+        r.price = sqlite3_column_int(stmt.get(), 2);
+        r.is_available = sqlite3_column_int(stmt.get(), 3) && !index.occupied(r.room_id, today);
         out.push_back(r);
     }
-    sqlite3_finalize(stmt);
     return out;
 }
 
 BookingResult Database::bookRoom(const std::string &name, int room_id,
                                  const std::string &check_in, const std::string &check_out) {
-    BookingResult res{false, "Unknown error", -1};
+    WriteCmd cmd;
+    cmd.kind = WriteCmd::Book;
+    if (!parse_date(check_in, cmd.from) || !parse_date(check_out, cmd.to) || cmd.to <= cmd.from)
+        return BookingResult{false, "Invalid dates (use YYYY-MM-DD, check_out after check_in)", -1};
+    cmd.name = name;
+    cmd.room_id = room_id;
+    cmd.check_in = check_in;
+    cmd.check_out = check_out;
+    return submit(std::move(cmd));
+}
 
-    // Check availability
-    const char *chk_sql = "SELECT is_available FROM rooms WHERE room_id = ?;";
-    sqlite3_stmt *chk_stmt = nullptr;
-    if (sqlite3_prepare_v2(db, chk_sql, -1, &chk_stmt, nullptr) != SQLITE_OK) {
-        res.message = "DB prepare error (check)";
-        return res;
+BookingResult Database::cancelBooking(int booking_id) {
+    WriteCmd cmd;
+    cmd.kind = WriteCmd::Cancel;
+    cmd.booking_id = booking_id;
+    return submit(std::move(cmd));
+}
+
+bool Database::bookRooms(const std::vector<BookingRequest> &requests, std::vector<BookingResult> &results) {
+    results.clear();
+    if (requests.empty()) return true;
+    WriteCmd cmd;
+    cmd.kind = WriteCmd::BookBatch;
+    cmd.items = requests;
+    cmd.nights.resize(requests.size());
+    std::vector<bool> bad_dates(requests.size(), false);
+    bool dates_ok = true;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        auto &n = cmd.nights[i];
+        bad_dates[i] = !parse_date(requests[i].check_in, n.first) ||
+                       !parse_date(requests[i].check_out, n.second) || n.second <= n.first;
+        if (bad_dates[i]) dates_ok = false;
     }
-    sqlite3_bind_int(chk_stmt, 1, room_id);
-    int rc = sqlite3_step(chk_stmt);
-    if (rc != SQLITE_ROW) {
-        sqlite3_finalize(chk_stmt);
-        res.message = "Room not found";
-        return res;
+    if (!dates_ok) {
+        for (size_t i = 0; i < requests.size(); ++i)
+            results.push_back(BookingResult{false, bad_dates[i]
+                                                       ? "Invalid dates (use YYYY-MM-DD, check_out after check_in)"
+                                                       : "Not booked: another booking in the batch failed", -1});
+        return false;
     }
-    int is_avail = sqlite3_column_int(chk_stmt, 0);
-    sqlite3_finalize(chk_stmt);
+    cmd.item_results = &results;
+    BookingResult r = submit(std::move(cmd));
+    // the writer never ran it (database closed)
+    if (results.size() != requests.size()) results.assign(requests.size(), BookingResult{false, r.message, -1});
+    return r.ok;
+}
 
-    if (!is_avail) {
-        res.message = "Room not available";
-        return res;
+bool Database::cancelBookings(const CancelSelection &sel, std::vector<BookingResult> &results) {
+    results.clear();
+    if (sel.booking_ids.empty() && !sel.room_id && (sel.from.empty() || sel.to.empty()))
+        return false;   // open-ended across every room: refuse rather than empty the hotel
+    WriteCmd cmd;
+    cmd.kind = WriteCmd::CancelBatch;
+    cmd.booking_ids = sel.booking_ids;
+    cmd.room_id = sel.room_id;
+    cmd.check_in = sel.from;
+    cmd.check_out = sel.to;
+    cmd.item_results = &results;
+    BookingResult r = submit(std::move(cmd));
+    if (!r.ok) {
+        results.clear();
+        for (int b : sel.booking_ids) results.push_back(BookingResult{false, r.message, b});
     }
+    return r.ok;
+}
 
-    // Begin transaction
-    char *err = nullptr;
-    sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, &err);
+// Queues a command for the writer thread and waits for its result.
+BookingResult Database::submit(WriteCmd cmd) {
+    std::future<BookingResult> result = cmd.done.get_future();
+    {
+        std::unique_lock<std::mutex> lock(queue_mtx);
+        queue_space.wait(lock, [this] { return stopping || queue.size() < writer_opts.queue_capacity; });
+        if (stopping || !writer.joinable())
+            return BookingResult{false, "Database not open", cmd.booking_id};
+        queue.push_back(std::move(cmd));
+    }
+    queue_cv.notify_one();
+    return result.get();
+}
 
-    // Insert booking
-    const char *ins_sql = "INSERT INTO bookings (customer_name, room_id, check_in, check_out, status) VALUES (?, ?, ?, ?, 'active');";
-    sqlite3_stmt *ins_stmt = nullptr;
-    if (sqlite3_prepare_v2(db, ins_sql, -1, &ins_stmt, nullptr) != SQLITE_OK) {
-        res.message = "DB prepare error (insert)";
-        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
-        return res;
+void Database::writerLoop() {
+    std::vector<WriteCmd> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mtx);
+            queue_cv.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;  // stopping, and everything is drained
+            if (writer_opts.max_delay.count() > 0 && queue.size() < writer_opts.max_batch) {
+                auto deadline = std::chrono::steady_clock::now() + writer_opts.max_delay;
+                queue_cv.wait_until(lock, deadline, [this] {
+                    return stopping || queue.size() >= writer_opts.max_batch;
+                });
+            }
+            while (!queue.empty() && batch.size() < writer_opts.max_batch) {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+        queue_space.notify_all();
+        applyBatch(batch);
+        batch.clear();
     }
-    sqlite3_bind_text(ins_stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(ins_stmt, 2, room_id);
-    sqlite3_bind_text(ins_stmt, 3, check_in.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(ins_stmt, 4, check_out.c_str(), -1, SQLITE_TRANSIENT);
+}
 
-    if (sqlite3_step(ins_stmt) != SQLITE_DONE) {
-        res.message = "Failed to insert booking";
-        sqlite3_finalize(ins_stmt);
-        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
-        return res;
+// Runs a batch in one transaction. Each command gets its own savepoint, so
+// one failing command does not take the others down with it; only a failed
+// COMMIT fails the whole batch.
+void Database::applyBatch(std::vector<WriteCmd> &batch) {
+    std::vector<BookingResult> results;
+    results.reserve(batch.size());
+    {
+        std::lock_guard<std::mutex> lock(write_mtx);
+        Lease conn(*this);
+        if (!conn || !run(*conn, Stmt::Begin)) {
+            for (auto &cmd : batch)
+                cmd.done.set_value(BookingResult{false, "Failed to begin transaction", cmd.booking_id});
+            return;
+        }
+        Conn &c = *conn;
+        std::vector<Undo> undo;
+        for (const auto &cmd : batch) {
+            switch (cmd.kind) {
+                case WriteCmd::Book: results.push_back(applyBook(c, cmd, undo)); break;
+                case WriteCmd::Cancel: results.push_back(applyCancel(c, cmd, undo)); break;
+                case WriteCmd::BookBatch: results.push_back(applyBookBatch(c, cmd, undo)); break;
+                case WriteCmd::CancelBatch: results.push_back(applyCancelBatch(c, cmd, undo)); break;
+            }
+        }
+
+        // only the writer moves the version, and only under write_mtx
+        uint64_t version = catalog_version.load(std::memory_order_acquire) + 1;
+        int today = today_day();
+        bool logged = true;
+        for (const auto &u : undo)
+            logged = logged && logChange(c, version, u.room_id, u.booking_id, u.added ? "booked" : "cancelled");
+        if (logged && change_rows >= writer_opts.change_log) {
+            std::shared_lock<std::shared_mutex> lock(change_mtx);
+            StmtScope prune(prepared(c, Stmt::PruneChanges));
+            if (prune) {
+                sqlite3_bind_int64(prune.get(), 1, (sqlite3_int64) change_floor);
+                if (sqlite3_step(prune.get()) == SQLITE_DONE) change_rows = 0;
+            }
+        }
+        bool committed = logged && run(c, Stmt::Commit);
+        if (!committed) {
+            run(c, Stmt::Rollback);
+            for (auto it = undo.rbegin(); it != undo.rend(); ++it) {
+                if (it->added) {
+                    index.remove(it->booking_id);
+                } else {
+                    index.add(it->booking_id, it->room_id, it->from, it->to);
+                }
+                calendar.mark(it->room_id, it->from, it->to, !it->added);
+            }
+            for (auto &r : results) {
+                if (!r.ok) continue;
+                r.ok = false;
+                r.message = "Failed to commit";
+            }
+            for (auto &cmd : batch) {
+                if (!cmd.item_results) continue;
+                for (auto &r : *cmd.item_results) {
+                    r.ok = false;
+                    if (cmd.kind == WriteCmd::BookBatch) r.booking_id = -1;
+                    r.message = "Failed to commit";
+                }
+            }
+        }
+        // readers may have seen the index mid-batch, so bump even if the
+        // batch was rolled back
+        if (!undo.empty()) {
+            std::vector<int> rooms;
+            if (committed)
+                for (const auto &u : undo) rooms.push_back(u.room_id);
+            advance(rooms, today);
+            if (committed && on_change) {
+                std::vector<RoomChange> changes;
+                changes.reserve(undo.size());
+                for (const auto &u : undo) {
+                    RoomChange ch;
+                    ch.kind = u.added ? RoomChange::Booked : RoomChange::Cancelled;
+                    ch.version = version;
+                    ch.room_id = u.room_id;
+                    ch.booking_id = u.booking_id;
+                    ch.from = u.from;
+                    ch.to = u.to;
+                    ch.is_available = calendar.has(u.room_id) && !index.occupied(u.room_id, today);
+                    changes.push_back(ch);
+                }
+                on_change(changes);
+            }
+        }
     }
-    sqlite3_finalize(ins_stmt);
+    for (size_t i = 0; i < batch.size(); ++i) batch[i].done.set_value(std::move(results[i]));
+}
 
-    // get last inserted id
-    int booking_id = (int) sqlite3_last_insert_rowid(db);
-
-    // mark room unavailable
-    const char *upd_sql = "UPDATE rooms SET is_available = 0 WHERE room_id = ?;";
-    sqlite3_stmt *upd_stmt = nullptr;
-    if (sqlite3_prepare_v2(db, upd_sql, -1, &upd_stmt, nullptr) != SQLITE_OK) {
-        res.message = "DB prepare error (update)";
-        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+// Whether the room exists and is in service.
+BookingResult Database::checkRoom(Conn &c, int room_id) {
+    StmtScope chk(prepared(c, Stmt::CheckRoom));
+    if (!chk) return BookingResult{false, "DB prepare error (check)", -1};
+    sqlite3_bind_int(chk.get(), 1, room_id);
+    if (sqlite3_step(chk.get()) != SQLITE_ROW) return BookingResult{false, "Room not found", -1};
+    if (!sqlite3_column_int(chk.get(), 0)) return BookingResult{false, "Room not available", -1};
+    return BookingResult{true, "", -1};
+}
+
+BookingResult Database::applyBook(Conn &c, const WriteCmd &cmd, std::vector<Undo> &undo) {
+    BookingResult res = checkRoom(c, cmd.room_id);
+    if (!res.ok) return res;
+    res = BookingResult{false, "Unknown error", -1};
+
+    // Only the writer thread touches the index, and it already holds the
+    // bookings made earlier in this batch.
+    if (index.overlaps(cmd.room_id, cmd.from, cmd.to)) {
+        res.message = "Room already booked for those dates";
         return res;
     }
-    sqlite3_bind_int(upd_stmt, 1, room_id);
-    if (sqlite3_step(upd_stmt) != SQLITE_DONE) {
-        sqlite3_finalize(upd_stmt);
-        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
-        res.message = "Failed to mark room booked";
+
+    if (!run(c, Stmt::Savepoint)) {
+        res.message = "Failed to begin booking";
         return res;
     }
-    sqlite3_finalize(upd_stmt);
 
-    // commit
-    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, &err);
+    // Insert booking
+    {
+        StmtScope ins(prepared(c, Stmt::InsertBooking));
+        if (!ins) {
+            res.message = "DB prepare error (insert)";
+            run(c, Stmt::RollbackTo);
+            run(c, Stmt::Release);
+            return res;
+        }
+        sqlite3_bind_text(ins.get(), 1, cmd.name.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(ins.get(), 2, cmd.room_id);
+        sqlite3_bind_text(ins.get(), 3, cmd.check_in.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(ins.get(), 4, cmd.check_out.c_str(), -1, SQLITE_STATIC);
+
+        if (sqlite3_step(ins.get()) != SQLITE_DONE) {
+            res.message = "Failed to insert booking";
+            run(c, Stmt::RollbackTo);
+            run(c, Stmt::Release);
+            return res;
+        }
+        // Another process sharing the file booked these nights; our index
+        // cannot see that, but the conditional insert under BEGIN IMMEDIATE
+        // can.
+        if (sqlite3_changes(c.db) == 0) {
+            run(c, Stmt::Release);
+            res.message = "Room already booked for those dates";
+            return res;
+        }
+    }
+    run(c, Stmt::Release);
+
+    // get last inserted id
+    int booking_id = (int) sqlite3_last_insert_rowid(c.db);
+
+    index.add(booking_id, cmd.room_id, cmd.from, cmd.to);
+    calendar.mark(cmd.room_id, cmd.from, cmd.to, true);
+    undo.push_back(Undo{true, booking_id, cmd.room_id, cmd.from, cmd.to});
 
     res.ok = true;
     res.booking_id = booking_id;
@@ -149,73 +1147,209 @@ BookingResult Database::bookRoom(const std::string &name, int room_id,
     return res;
 }
 
-BookingResult Database::cancelBooking(int booking_id) {
-    BookingResult res{false, "Unknown error", booking_id};
+// All of cmd.items or nothing: every item is checked against the rooms, the
+// index and the other items before the first insert, and a failed insert
+// rolls the whole group back to its savepoint.
+BookingResult Database::applyBookBatch(Conn &c, const WriteCmd &cmd, std::vector<Undo> &undo) {
+    std::vector<BookingResult> &results = *cmd.item_results;
+    const size_t n = cmd.items.size();
+    results.assign(n, BookingResult{false, "Not booked: another booking in the batch failed", -1});
+    std::vector<bool> bad(n, false);
+    size_t failed = 0;
+    auto fail = [&](size_t i, const char *why) {
+        if (!bad[i]) {
+            bad[i] = true;
+            ++failed;
+        }
+        results[i].message = why;
+    };
 
-    // find booking
-    const char *q = "SELECT room_id, status FROM bookings WHERE booking_id = ?;";
-    sqlite3_stmt *stmt = nullptr;
-    if (sqlite3_prepare_v2(db, q, -1, &stmt, nullptr) != SQLITE_OK) {
-        res.message = "DB prepare error (find)";
-        return res;
+    for (size_t i = 0; i < n; ++i) {
+        BookingResult chk = checkRoom(c, cmd.items[i].room_id);
+        if (!chk.ok) fail(i, chk.message.c_str());
+        else if (index.overlaps(cmd.items[i].room_id, cmd.nights[i].first, cmd.nights[i].second))
+            fail(i, "Room already booked for those dates");
     }
-    sqlite3_bind_int(stmt, 1, booking_id);
-    int rc = sqlite3_step(stmt);
-    if (rc != SQLITE_ROW) {
-        sqlite3_finalize(stmt);
-        res.message = "Booking not found";
-        return res;
+    // items of the same room, by first night: each must start after every
+    // earlier one has ended
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (cmd.items[a].room_id != cmd.items[b].room_id) return cmd.items[a].room_id < cmd.items[b].room_id;
+        return cmd.nights[a].first < cmd.nights[b].first;
+    });
+    for (size_t k = 1, last = order[0]; k < n; ++k) {
+        size_t i = order[k];
+        if (cmd.items[i].room_id != cmd.items[last].room_id) {
+            last = i;
+            continue;
+        }
+        if (cmd.nights[i].first < cmd.nights[last].second) {
+            fail(i, "Overlaps another booking in this batch");
+            fail(last, "Overlaps another booking in this batch");
+        }
+        if (cmd.nights[i].second > cmd.nights[last].second) last = i;
     }
-    int room_id = sqlite3_column_int(stmt, 0);
-    const unsigned char *st = sqlite3_column_text(stmt, 1);
-    std::string status = st ? reinterpret_cast<const char*>(st) : "";
-    sqlite3_finalize(stmt);
+    auto summary = [&] {
+        return BookingResult{false, std::to_string(failed) + " of " + std::to_string(n) +
+                                        " bookings cannot be made; nothing was booked", -1};
+    };
+    if (failed) return summary();
 
-    if (status == "cancelled") {
-        res.message = "Booking already cancelled";
-        return res;
+    if (!run(c, Stmt::Savepoint)) return BookingResult{false, "Failed to begin booking", -1};
+    StmtScope ins(prepared(c, Stmt::InsertBooking));
+    for (size_t i = 0; i < n && ins; ++i) {
+        const BookingRequest &b = cmd.items[i];
+        sqlite3_reset(ins.get());
+        sqlite3_bind_text(ins.get(), 1, b.name.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(ins.get(), 2, b.room_id);
+        sqlite3_bind_text(ins.get(), 3, b.check_in.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(ins.get(), 4, b.check_out.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(ins.get()) != SQLITE_DONE) fail(i, "Failed to insert booking");
+        // booked by another process sharing the file, see applyBook
+        else if (sqlite3_changes(c.db) == 0) fail(i, "Room already booked for those dates");
+        else results[i].booking_id = (int) sqlite3_last_insert_rowid(c.db);
+        if (failed) break;
+    }
+    if (!ins || failed) {
+        if (!ins) fail(0, "DB prepare error (insert)");
+        run(c, Stmt::RollbackTo);
+        run(c, Stmt::Release);
+        for (auto &r : results) r.booking_id = -1;
+        return summary();
     }
+    run(c, Stmt::Release);
 
-    // Begin transaction
-    char *err = nullptr;
-    sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, &err);
-
-    // update booking status
-    const char *upd_book = "UPDATE bookings SET status = 'cancelled' WHERE booking_id = ?;";
-    sqlite3_stmt *upd_stmt = nullptr;
-    if (sqlite3_prepare_v2(db, upd_book, -1, &upd_stmt, nullptr) != SQLITE_OK) {
-        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
-        res.message = "DB prepare error (update booking)";
-        return res;
+    for (size_t i = 0; i < n; ++i) {
+        const BookingRequest &b = cmd.items[i];
+        int booking_id = results[i].booking_id;
+        index.add(booking_id, b.room_id, cmd.nights[i].first, cmd.nights[i].second);
+        calendar.mark(b.room_id, cmd.nights[i].first, cmd.nights[i].second, true);
+        undo.push_back(Undo{true, booking_id, b.room_id, cmd.nights[i].first, cmd.nights[i].second});
+        results[i].ok = true;
+        results[i].message = "Booked successfully. Booking ID: " + std::to_string(booking_id);
     }
-    sqlite3_bind_int(upd_stmt, 1, booking_id);
-    if (sqlite3_step(upd_stmt) != SQLITE_DONE) {
-        sqlite3_finalize(upd_stmt);
-        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
-        res.message = "Failed to update booking";
-        return res;
+    return BookingResult{true, "Booked " + std::to_string(n) + " rooms", results[0].booking_id};
+}
+
+// One UPDATE for the whole selection; the ids it returns are then taken out
+// of the index and calendar. Only ids the UPDATE skipped are looked up, to
+// tell "already cancelled" from "not found".
+BookingResult Database::applyCancelBatch(Conn &c, const WriteCmd &cmd, std::vector<Undo> &undo) {
+    std::vector<BookingResult> &results = *cmd.item_results;
+    results.clear();
+    auto ids_json = [](const std::vector<int> &ids) {
+        std::string s = "[";
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (i) s += ',';
+            s += std::to_string(ids[i]);
+        }
+        return s + "]";
+    };
+
+    std::string list;
+    Stmt id = cmd.booking_ids.empty() ? (cmd.room_id ? Stmt::CancelRoomRange : Stmt::CancelRange)
+                                      : Stmt::CancelBookings;
+    std::vector<int> cancelled;
+    if (!run(c, Stmt::Savepoint)) return BookingResult{false, "Failed to begin cancellation", -1};
+    int rc;
+    {
+        StmtScope upd(prepared(c, id));
+        if (!upd) {
+            run(c, Stmt::Release);
+            return BookingResult{false, "DB prepare error (cancel)", -1};
+        }
+        if (id == Stmt::CancelBookings) {
+            list = ids_json(cmd.booking_ids);
+            sqlite3_bind_text(upd.get(), 1, list.c_str(), -1, SQLITE_STATIC);
+        } else {
+            int p = 1;
+            if (cmd.room_id) sqlite3_bind_int(upd.get(), p++, cmd.room_id);
+            // dates are compared as text, and these sort before and after any date
+            const std::string &from = cmd.check_in.empty() ? std::string("0000-00-00") : cmd.check_in;
+            const std::string &to = cmd.check_out.empty() ? std::string("9999-99-99") : cmd.check_out;
+            sqlite3_bind_text(upd.get(), p++, from.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(upd.get(), p, to.c_str(), -1, SQLITE_TRANSIENT);
+        }
+        while ((rc = sqlite3_step(upd.get())) == SQLITE_ROW) cancelled.push_back(sqlite3_column_int(upd.get(), 0));
+    }
+    if (rc != SQLITE_DONE) {
+        run(c, Stmt::RollbackTo);
+        run(c, Stmt::Release);
+        return BookingResult{false, "Failed to update bookings", -1};
     }
-    sqlite3_finalize(upd_stmt);
+    run(c, Stmt::Release);
 
-    // set room available
-    const char *upd_room = "UPDATE rooms SET is_available = 1 WHERE room_id = ?;";
-    sqlite3_stmt *up2 = nullptr;
-    if (sqlite3_prepare_v2(db, upd_room, -1, &up2, nullptr) != SQLITE_OK) {
-        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
-        res.message = "DB prepare error (update room)";
-        return res;
+    for (int booking_id : cancelled) {
+        BookingIndex::Range freed;
+        if (index.remove(booking_id, &freed)) {
+            calendar.mark(freed.room_id, freed.from, freed.to, false);
+            undo.push_back(Undo{false, booking_id, freed.room_id, freed.from, freed.to});
+        }
     }
-    sqlite3_bind_int(up2, 1, room_id);
-    if (sqlite3_step(up2) != SQLITE_DONE) {
-        sqlite3_finalize(up2);
-        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
-        res.message = "Failed to mark room available";
-        return res;
+    BookingResult summary{true, "Cancelled " + std::to_string(cancelled.size()) + " bookings", -1};
+    if (id != Stmt::CancelBookings) {
+        for (int booking_id : cancelled) results.push_back(BookingResult{true, "Booking cancelled", booking_id});
+        return summary;
+    }
+
+    std::sort(cancelled.begin(), cancelled.end());
+    std::vector<int> rest, existing;
+    for (int b : cmd.booking_ids)
+        if (!std::binary_search(cancelled.begin(), cancelled.end(), b)) rest.push_back(b);
+    if (!rest.empty()) {
+        list = ids_json(rest);
+        StmtScope find(prepared(c, Stmt::FindBookings));
+        if (find) {
+            sqlite3_bind_text(find.get(), 1, list.c_str(), -1, SQLITE_STATIC);
+            while (sqlite3_step(find.get()) == SQLITE_ROW) existing.push_back(sqlite3_column_int(find.get(), 0));
+        }
+        std::sort(existing.begin(), existing.end());
+    }
+    for (int b : cmd.booking_ids) {
+        if (std::binary_search(cancelled.begin(), cancelled.end(), b))
+            results.push_back(BookingResult{true, "Booking cancelled", b});
+        else if (std::binary_search(existing.begin(), existing.end(), b))
+            results.push_back(BookingResult{false, "Booking already cancelled", b});
+        else
+            results.push_back(BookingResult{false, "Booking not found", b});
     }
-    sqlite3_finalize(up2);
+    return summary;
+}
 
-    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, &err);
+BookingResult Database::applyCancel(Conn &c, const WriteCmd &cmd, std::vector<Undo> &undo) {
+    int booking_id = cmd.booking_id;
+    BookingResult res{false, "Unknown error", booking_id};
+
+    // update booking status; a single statement needs no savepoint, and
+    // the status guard makes a concurrent second cancel a no-op
+    {
+        StmtScope upd(prepared(c, Stmt::CancelBooking));
+        if (!upd) {
+            res.message = "DB prepare error (update booking)";
+            return res;
+        }
+        sqlite3_bind_int(upd.get(), 1, booking_id);
+        if (sqlite3_step(upd.get()) != SQLITE_DONE) {
+            res.message = "Failed to update booking";
+            return res;
+        }
+        if (sqlite3_changes(c.db) == 0) {
+            // nothing changed: tell "never existed" apart from "already cancelled"
+            StmtScope stmt(prepared(c, Stmt::FindBooking));
+            if (stmt) sqlite3_bind_int(stmt.get(), 1, booking_id);
+            res.message = stmt && sqlite3_step(stmt.get()) == SQLITE_ROW
+                              ? "Booking already cancelled" : "Booking not found";
+            return res;
+        }
+    }
+
+    BookingIndex::Range freed;
+    if (index.remove(booking_id, &freed)) {
+        calendar.mark(freed.room_id, freed.from, freed.to, false);
+        undo.push_back(Undo{false, booking_id, freed.room_id, freed.from, freed.to});
+    }
     res.ok = true;
-    res.message = "Booking cancelled and room marked available";
+    res.message = "Booking cancelled";
     return res;
 }
@@ -0,0 +1,313 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <condition_variable>
+#include <map>
+#include <shared_mutex>
+#include <deque>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include "booking_index.h"
+#include "calendar.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+struct Room {
+    int room_id = 0;
+    std::string type;
+    int price = 0;
+    // 1 if the room is in service and nobody is booked into it tonight
+    int is_available = 1;
+};
+
+// Filter for Database::findAvailable. from/to are day numbers (see
+// parse_date); an empty type or negative max_price means "any".
+struct AvailabilityQuery {
+    int from = 0;
+    int to = 0;
+    std::string type;
+    int max_price = -1;
+};
+
+struct BookingResult {
+    bool ok;
+    std::string message;
+    int booking_id;
+};
+
+// Bookings for Database::cancelBookings to cancel: the listed ids, or
+// else every active booking of room_id (0 = any room) with a night in
+// [from, to). from/to are YYYY-MM-DD; empty leaves that end open, which
+// is only allowed for one room: a hotel-wide range needs both ends.
+struct CancelSelection {
+    std::vector<int> booking_ids;
+    int room_id = 0;
+    std::string from, to;
+};
+
+// One booking of a Database::bookRooms batch; dates as for bookRoom.
+struct BookingRequest {
+    std::string name;
+    int room_id = 0;
+    std::string check_in, check_out;
+};
+
+// Outcome of Database::bulkImport. Bad lines are skipped and counted; the
+// first few are described in errors.
+struct ImportStats {
+    long long rooms = 0;
+    long long bookings = 0;
+    long long rejected = 0;
+    std::vector<std::string> errors;
+};
+
+// SQLite memory and page-cache figures for monitoring, see Database::dbStats.
+struct DbStats {
+    // process-wide, from sqlite3_status64
+    long long memory_used = 0;
+    long long memory_highwater = 0;
+    long long malloc_count = 0;
+    long long pagecache_overflow = 0;
+    // summed over the pool, from sqlite3_db_status
+    long long cache_used = 0;      // bytes
+    long long cache_hit = 0;
+    long long cache_miss = 0;
+    long long cache_write = 0;
+    long long stmt_used = 0;       // bytes held by prepared statements
+    int connections = 0;
+    int idle_connections = 0;
+    size_t write_queue = 0;        // bookings/cancellations waiting for the writer
+};
+
+// One committed change to a room's bookings, passed to the listener set with
+// Database::setChangeListener. Reloaded (after a bulk import) means any room
+// may have changed and only version is set.
+struct RoomChange {
+    enum Kind { Booked, Cancelled, Reloaded };
+    Kind kind = Booked;
+    uint64_t version = 0;    // catalogVersion() once the change was committed
+    int room_id = 0;
+    int booking_id = 0;
+    int from = 0, to = 0;    // nights [from, to) taken or freed
+    int is_available = 1;    // the room's state tonight after the change
+};
+using ChangeListener = std::function<void(const std::vector<RoomChange> &)>;
+
+// Group commit for the writer thread. It takes whatever is queued, up to
+// max_batch commands, and applies them in one transaction. If fewer than
+// max_batch are waiting it lingers up to max_delay for more; the default of
+// zero still batches everything that queued up during the previous commit.
+// Producers block once queue_capacity commands are waiting.
+struct WriterOptions {
+    size_t max_batch = 64;
+    std::chrono::microseconds max_delay{0};
+    size_t queue_capacity = 1024;
+    // room changes remembered for Database::changedRooms
+    size_t change_log = 65536;
+};
+
+// Every statement the Database runs on the hot path. Each one is prepared
+// once on first use and kept until close().
+enum class Stmt {
+    Begin,
+    Commit,
+    Rollback,
+    Savepoint,
+    Release,
+    RollbackTo,
+    GetRooms,
+    CheckRoom,
+    InsertBooking,
+    FindBooking,
+    CancelBooking,
+    LoadActiveBookings,
+    GetRoom,
+    InsertChange,
+    PruneChanges,
+    LoadChanges,
+    CancelBookings,
+    FindBookings,
+    CancelRoomRange,
+    CancelRange,
+    Count
+};
+
+class Database {
+public:
+    Database() = default;
+    ~Database();
+    Database(const Database &) = delete;
+    Database &operator=(const Database &) = delete;
+
+    // Opens pool_size connections to dbfile in WAL mode (0 = one per
+    // hardware thread) and applies any pending schema migrations; seed_file
+    // is loaded only when the DB is first created. Readers check out a
+    // connection each and run in parallel; bookings and cancellations are
+    // queued to a single writer thread that commits them in batches.
+    bool open(const std::string &dbfile, const std::string &seed_file, int pool_size = 0,
+              const WriterOptions &writer = WriterOptions());
+    void close();
+
+    std::vector<Room> getRooms();
+    // Bumped after every committed change to rooms or bookings, so callers
+    // can cache anything derived from getRooms() until it moves.
+    uint64_t catalogVersion() const { return catalog_version.load(std::memory_order_acquire); }
+    // Rooms whose bookings changed after catalog version `since`, current as
+    // of `version` or later. Answered from the change log; returns false if
+    // the log cannot tell: `since` has aged out of it, a bulk import came
+    // after it, or it was handed out before today (tonight's states all
+    // moved at midnight). The caller then needs all of getRooms().
+    bool changedRooms(uint64_t since, std::vector<Room> &out, uint64_t &version);
+    // Called after every commit with the changes it made, in commit order,
+    // on the writer thread while bookings wait, so it must not block.
+    void setChangeListener(ChangeListener listener);
+    // In-service rooms free for every night in [q.from, q.to), cheapest
+    // first within each type. Answered from memory, no SQL.
+    std::vector<Room> findAvailable(const AvailabilityQuery &q) const;
+    // Free in-service rooms of `type` ("" = all) for each of `nights` nights
+    // from day `from`, read off the occupancy bitmap. Covers today through
+    // at least a year ahead; returns false outside that.
+    bool freeRoomCounts(const std::string &type, int from, int nights,
+                        std::vector<int> &out, int &total);
+    // check_in/check_out are YYYY-MM-DD; the guest occupies the nights
+    // [check_in, check_out). Fails if any of those nights is already taken.
+    BookingResult bookRoom(const std::string &name, int room_id,
+                           const std::string &check_in, const std::string &check_out);
+    BookingResult cancelBooking(int booking_id);
+    // Books all of `requests` in one transaction, or none of them. Every
+    // request is checked before anything is written (room in service,
+    // nights free, no overlap with another request of the batch); results
+    // gets one entry per request saying what failed. Returns true if
+    // everything was booked.
+    bool bookRooms(const std::vector<BookingRequest> &requests, std::vector<BookingResult> &results);
+    // Cancels everything `sel` picks with one set-based UPDATE in one
+    // transaction, freeing the rooms in the same pass. results gets an
+    // entry per listed id (cancelled, already cancelled, not found), or per
+    // booking cancelled when selecting by room and dates. Returns false if
+    // the transaction failed and nothing was cancelled.
+    bool cancelBookings(const CancelSelection &sel, std::vector<BookingResult> &results);
+
+    // Streams rooms and bookings from a .csv or .jsonl file (format in
+    // import_reader.h). Rooms are upserted, bookings appended; an active
+    // booking needs check_in < check_out and must not overlap another
+    // active booking of its room. Runs with synchronous=OFF, commits every
+    // chunk_rows rows, and rebuilds the bookings indexes once at the end.
+    // Blocks bookings while it runs. Returns false only if the load itself
+    // fails; bad lines go to stats.
+    bool bulkImport(const std::string &path, ImportStats &stats, long long chunk_rows = 500000);
+
+    // Runs EXPLAIN QUERY PLAN over every cached statement and returns the
+    // ones that would scan a whole table instead of using an index
+    // (statements that read a full table on purpose are skipped).
+    std::vector<std::string> fullScans();
+
+    // A snapshot for /metrics. A connection that is checked out while this
+    // runs contributes the figures it had when it was last seen idle.
+    DbStats dbStats();
+
+private:
+    // One sqlite3 handle plus its statement cache. Only ever used by the
+    // thread that currently holds it checked out.
+    struct Conn {
+        sqlite3 *db = nullptr;
+        sqlite3_stmt *stmts[static_cast<int>(Stmt::Count)] = {};
+        long long status[5] = {};   // last sqlite3_db_status reading, see dbStats
+    };
+    class Lease;
+
+    // A queued booking, cancellation or batch of either and the promise its
+    // caller waits on. The batches also fill item_results, which lives with
+    // the caller until done is set. A CancelBatch uses booking_ids, or
+    // room_id with check_in/check_out as the date range.
+    struct WriteCmd {
+        enum Kind { Book, Cancel, BookBatch, CancelBatch } kind;
+        std::string name;
+        int room_id = 0;
+        std::string check_in, check_out;
+        int from = 0, to = 0;
+        int booking_id = 0;
+        std::vector<BookingRequest> items;
+        std::vector<int> booking_ids;
+        std::vector<std::pair<int, int>> nights;   // [from, to) of each item
+        std::vector<BookingResult> *item_results = nullptr;
+        std::promise<BookingResult> done;
+    };
+    // Index/calendar changes made by a batch, replayed backwards if its
+    // commit fails.
+    struct Undo {
+        bool added;
+        int booking_id, room_id, from, to;
+    };
+
+    static bool execSqlFile(Conn &c, const std::string &sqlfile);
+    static bool migrate(Conn &c, const std::string &seed_file);
+    static sqlite3_stmt *prepared(Conn &c, Stmt id);
+    static bool run(Conn &c, Stmt id);
+    static void closeConn(Conn &c);
+
+    Conn *acquire();
+    void release(Conn *c);
+    bool loadBookings(Conn &c);
+    bool loadCatalog(Conn &c);
+    void rebuildCalendar(int base_day);
+
+    bool loadChangeLog(Conn &c, uint64_t &last);
+    bool logChange(Conn &c, uint64_t version, int room_id, int booking_id, const char *change);
+    uint64_t advance(const std::vector<int> &room_ids, int day);
+    void markDay(int today);
+
+    BookingResult submit(WriteCmd cmd);
+    void writerLoop();
+    void applyBatch(std::vector<WriteCmd> &batch);
+    BookingResult applyBook(Conn &c, const WriteCmd &cmd, std::vector<Undo> &undo);
+    BookingResult applyCancel(Conn &c, const WriteCmd &cmd, std::vector<Undo> &undo);
+    BookingResult applyBookBatch(Conn &c, const WriteCmd &cmd, std::vector<Undo> &undo);
+    BookingResult applyCancelBatch(Conn &c, const WriteCmd &cmd, std::vector<Undo> &undo);
+    BookingResult checkRoom(Conn &c, int room_id);
+
+    std::vector<std::unique_ptr<Conn>> conns;
+    std::vector<Conn *> idle;
+    std::mutex pool_mtx;
+    std::condition_variable pool_cv;
+    // Held by the writer thread for each batch, and by anything else that
+    // must not interleave with one (calendar rebuild).
+    std::mutex write_mtx;
+
+    WriterOptions writer_opts;
+    std::deque<WriteCmd> queue;
+    std::mutex queue_mtx;
+    std::condition_variable queue_cv;      // writer waits for work
+    std::condition_variable queue_space;   // producers wait for room
+    bool stopping = false;
+    std::thread writer;
+    // active bookings, mirrored from the bookings table after each commit
+    BookingIndex index;
+    // in-service rooms grouped by type, each group sorted by price
+    std::map<std::string, std::vector<Room>> catalog;
+    mutable std::shared_mutex catalog_mtx;
+    // per-night occupancy of the catalog rooms, kept in step with index
+    AvailabilityCalendar calendar;
+    std::atomic<uint64_t> catalog_version{1};
+    ChangeListener on_change;   // guarded by write_mtx
+
+    // Recent room changes, oldest first, mirrored in the room_changes table
+    // (which is pruned behind it). room_id 0 stands for every room (a bulk
+    // import) and -1 for none: a marker giving the first version of a day.
+    struct LoggedChange {
+        uint64_t version;
+        int room_id;
+        int day;    // when it was committed
+    };
+    std::deque<LoggedChange> change_log;
+    uint64_t change_floor = 0;      // a `since` this old or newer can be answered
+    int change_floor_day = 0;       // day change_floor was current
+    mutable std::shared_mutex change_mtx;
+    size_t change_rows = 0;         // room_changes rows written since the last prune; writer only
+};
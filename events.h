@@ -0,0 +1,458 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include "booking_index.h"
+#include "database.h"
+#include "json_writer.h"
+
+struct EventOptions {
+    int port = 18081;                     // own listener for /events; 0 = no event stream
+    int max_subscribers = 10000;
+    size_t backlog = 4096;                // events kept for reconnects to resume from
+    size_t max_buffered = 256u << 10;     // unsent bytes before a slow subscriber is dropped
+    std::chrono::seconds heartbeat{15};
+};
+
+// Server-Sent Events stream of room changes (GET /events). The HTTP server
+// gives each connection a worker for as long as it stays open, so a
+// subscriber that idles for hours would pin one; instead the stream has its
+// own listening socket served by a single thread that poll()s every
+// subscriber, writes non-blocking and keeps what a socket would not take in
+// that subscriber's buffer. Per commit each change is formatted once as
+//   id: <catalog version>          (on the last change of a commit only)
+//   event: room
+//   data: {"version":..,"room_id":..,"change":"booked","check_in":..,"check_out":..,"is_available":0}
+// and appended to every subscriber. The last `backlog` events are kept, so
+// a client reconnecting with Last-Event-ID (or ?since=VERSION) gets what it
+// missed; one too far behind, or from before a restart, gets a "reset"
+// event and should reload /rooms. A subscriber that lets more than
+// max_buffered bytes pile up is disconnected and resumes the same way.
+class EventStream {
+public:
+    explicit EventStream(const EventOptions &opts) : opts_(opts) {}
+
+    ~EventStream() { stop(); }
+
+    EventStream(const EventStream &) = delete;
+    EventStream &operator=(const EventStream &) = delete;
+
+    // Binds host:port and starts the fan-out thread; version is the
+    // current catalog version, the oldest a client can resume from.
+    bool start(const std::string &host, uint64_t version) {
+        floor_ = version_ = version;
+        if (!makeWakePair()) {
+            std::cerr << "Event stream: cannot create wake-up socket\n";
+            return false;
+        }
+        // resolve host as httplib does, so names and IPv6 addresses bind
+        // where the HTTP server does instead of silently on every interface
+        addrinfo hints{}, *found = nullptr;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        std::string port = std::to_string(opts_.port);
+        if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found) != 0) {
+            std::cerr << "Event stream: cannot resolve host " << host << "\n";
+            return false;
+        }
+        for (addrinfo *ai = found; ai && listener_ == kNone; ai = ai->ai_next) {
+            listener_ = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (listener_ == kNone) continue;
+            int one = 1;
+            setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, (const char *) &one, sizeof one);
+            if (bind(listener_, ai->ai_addr, (socklen_t) ai->ai_addrlen) != 0 || listen(listener_, 512) != 0) {
+                closeSocket(listener_);
+                listener_ = kNone;
+            }
+        }
+        freeaddrinfo(found);
+        if (listener_ == kNone) {
+            std::cerr << "Event stream: cannot listen on " << host << ":" << opts_.port << "\n";
+            return false;
+        }
+        setNonBlocking(listener_);
+        thread_ = std::thread(&EventStream::loop, this);
+        return true;
+    }
+
+    void stop() {
+        if (!thread_.joinable()) return;
+        stopping_.store(true, std::memory_order_release);
+        wake();
+        thread_.join();
+    }
+
+    // Database change listener: formats the changes and hands them to the
+    // fan-out thread.
+    void publish(const std::vector<RoomChange> &changes) {
+        std::string text;
+        for (size_t i = 0; i < changes.size(); ++i) format(text, changes[i], i + 1 == changes.size());
+        if (changes.empty()) return;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            pending_.push_back(Pending{changes.back().version, std::move(text)});
+        }
+        published_.fetch_add(changes.size(), std::memory_order_relaxed);
+        wake();
+    }
+
+    int subscribers() const { return subscribers_.load(std::memory_order_relaxed); }
+    uint64_t published() const { return published_.load(std::memory_order_relaxed); }
+    uint64_t droppedSlow() const { return dropped_slow_.load(std::memory_order_relaxed); }
+
+private:
+#ifdef _WIN32
+    using socket_t = SOCKET;
+    static constexpr socket_t kNone = INVALID_SOCKET;
+    static int pollFds(pollfd *fds, size_t n, int ms) { return WSAPoll(fds, (ULONG) n, ms); }
+    static void closeSocket(socket_t s) { closesocket(s); }
+    static void setNonBlocking(socket_t s) {
+        u_long on = 1;
+        ioctlsocket(s, FIONBIO, &on);
+    }
+    static bool wouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+#else
+    using socket_t = int;
+    static constexpr socket_t kNone = -1;
+    static int pollFds(pollfd *fds, size_t n, int ms) { return poll(fds, (nfds_t) n, ms); }
+    static void closeSocket(socket_t s) { ::close(s); }
+    static void setNonBlocking(socket_t s) { fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK); }
+    static bool wouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+#endif
+#ifdef MSG_NOSIGNAL
+    static constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+    static constexpr int kSendFlags = 0;
+#endif
+    static const size_t kMaxRequest = 8192;
+    static constexpr std::chrono::seconds kRequestTimeout{10};
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending {
+        uint64_t version;
+        std::string text;
+    };
+    struct Subscriber {
+        socket_t sock;
+        bool streaming = false;      // false while the request is still being read
+        Clock::time_point since;     // connected at, until streaming
+        std::string in;
+        std::string out;
+        size_t sent = 0;             // of out
+    };
+
+    // "id:" goes on the last change of a commit only, so a client cut off
+    // halfway through a commit resumes from the previous one.
+    static void format(std::string &out, const RoomChange &c, bool last) {
+        if (c.kind == RoomChange::Reloaded) {
+            reset(out, c.version);
+            return;
+        }
+        if (last) out += "id: " + std::to_string(c.version) + "\n";
+        out += "event: room\ndata: ";
+        JsonWriter w(out);
+        w.beginObject();
+        w.key("version").value(c.version);
+        w.key("room_id").value(c.room_id);
+        w.key("change").value(c.kind == RoomChange::Booked ? "booked" : "cancelled");
+        w.key("booking_id").value(c.booking_id);
+        w.key("check_in").value(format_date(c.from));
+        w.key("check_out").value(format_date(c.to));
+        w.key("is_available").value(c.is_available);
+        w.endObject();
+        out += "\n\n";
+    }
+
+    static void reset(std::string &out, uint64_t version) {
+        std::string v = std::to_string(version);
+        out += "id: " + v + "\nevent: reset\ndata: {\"version\":" + v + "}\n\n";
+    }
+
+    // A connected pair of loopback sockets; a byte written to one end wakes
+    // poll() on the other. (A pipe would do on POSIX, but WSAPoll only
+    // takes sockets.)
+    bool makeWakePair() {
+        socket_t l = socket(AF_INET, SOCK_STREAM, 0);
+        if (l == kNone) return false;
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof addr;
+        bool ok = bind(l, (sockaddr *) &addr, sizeof addr) == 0 && listen(l, 1) == 0 &&
+                  getsockname(l, (sockaddr *) &addr, &len) == 0;
+        if (ok) {
+            wake_send_ = socket(AF_INET, SOCK_STREAM, 0);
+            ok = wake_send_ != kNone && connect(wake_send_, (sockaddr *) &addr, sizeof addr) == 0;
+        }
+        if (ok) {
+            wake_recv_ = accept(l, nullptr, nullptr);
+            ok = wake_recv_ != kNone;
+        }
+        closeSocket(l);
+        if (!ok) return false;
+        setNonBlocking(wake_send_);
+        setNonBlocking(wake_recv_);
+        return true;
+    }
+
+    void wake() {
+        char b = 1;
+        // a full socket already has a wake-up waiting
+        send(wake_send_, &b, 1, kSendFlags);
+    }
+
+    void loop() {
+        std::vector<pollfd> fds;
+        auto next_beat = Clock::now() + opts_.heartbeat;
+        while (!stopping_.load(std::memory_order_acquire)) {
+            fds.clear();
+            fds.push_back(pollfd{wake_recv_, POLLIN, 0});
+            fds.push_back(pollfd{listener_, POLLIN, 0});
+            for (const auto &s : subs_)
+                fds.push_back(pollfd{s->sock, (short) (s->sent < s->out.size() ? POLLIN | POLLOUT : POLLIN), 0});
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_beat - Clock::now());
+            pollFds(fds.data(), fds.size(), (int) std::max<long long>(0, std::min<long long>(wait.count(), 1000)));
+
+            if (fds[0].revents) {
+                char buf[256];
+                while (recv(wake_recv_, buf, sizeof buf, 0) > 0) {}
+                broadcast();
+            }
+            // subs_ only grows below this point, so fds[i + 2] still lines up
+            size_t polled = subs_.size();
+            if (fds[1].revents & POLLIN) acceptAll();
+            auto now = Clock::now();
+            for (size_t i = 0; i < polled; ++i) {
+                Subscriber &s = *subs_[i];
+                short ev = fds[i + 2].revents;
+                if (s.sock == kNone) continue;
+                if (ev & (POLLERR | POLLHUP | POLLNVAL)) drop(s);
+                else if ((ev & POLLIN) && !readFrom(s)) drop(s);
+                else if (!s.streaming && now - s.since > kRequestTimeout) drop(s);
+                else if ((ev & POLLOUT) && !flush(s)) drop(s);
+            }
+            if (now >= next_beat) {
+                next_beat = now + opts_.heartbeat;
+                // a comment line: keeps proxies from timing the stream out
+                // and turns up peers that went away without closing
+                for (auto &s : subs_)
+                    if (s->sock != kNone && s->streaming && !enqueue(*s, ":\n\n")) drop(*s);
+            }
+            subs_.erase(std::remove_if(subs_.begin(), subs_.end(),
+                                       [](const std::unique_ptr<Subscriber> &s) { return s->sock == kNone; }),
+                        subs_.end());
+            subscribers_.store((int) subs_.size(), std::memory_order_relaxed);
+        }
+        for (auto &s : subs_) drop(*s);
+        closeSocket(listener_);
+        closeSocket(wake_send_);
+        closeSocket(wake_recv_);
+    }
+
+    // Moves what publish() queued into the backlog and out to everyone.
+    void broadcast() {
+        std::deque<Pending> batch;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            batch.swap(pending_);
+        }
+        for (auto &p : batch) {
+            for (auto &s : subs_)
+                if (s->sock != kNone && s->streaming && !enqueue(*s, p.text)) drop(*s);
+            version_ = p.version;
+            backlog_.push_back(std::move(p));
+            while (backlog_.size() > opts_.backlog) {
+                floor_ = backlog_.front().version;
+                backlog_.pop_front();
+            }
+        }
+    }
+
+    void acceptAll() {
+        for (;;) {
+            socket_t c = accept(listener_, nullptr, nullptr);
+            if (c == kNone) return;
+            if ((int) subs_.size() >= opts_.max_subscribers) {
+                static const char full[] =
+                    "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 5\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+                send(c, full, sizeof full - 1, kSendFlags);
+                closeSocket(c);
+                continue;
+            }
+            setNonBlocking(c);
+            int one = 1;
+            setsockopt(c, IPPROTO_TCP, TCP_NODELAY, (const char *) &one, sizeof one);
+            auto s = std::make_unique<Subscriber>();
+            s->sock = c;
+            s->since = Clock::now();
+            subs_.push_back(std::move(s));
+        }
+    }
+
+    // False once the peer has closed or sent something unusable.
+    bool readFrom(Subscriber &s) {
+        char buf[2048];
+        for (;;) {
+            int n = (int) recv(s.sock, buf, sizeof buf, 0);
+            if (n == 0) return false;
+            if (n < 0) return wouldBlock();
+            // once streaming, anything the client sends is ignored
+            if (s.streaming) continue;
+            s.in.append(buf, (size_t) n);
+            if (s.in.find("\r\n\r\n") != std::string::npos) return answer(s);
+            if (s.in.size() > kMaxRequest) return false;
+        }
+    }
+
+    // Replies to the request in s.in: the stream headers and whatever the
+    // client missed since the version it resumes from.
+    bool answer(Subscriber &s) {
+        std::string_view req(s.in);
+        std::string_view line = req.substr(0, req.find("\r\n"));
+        std::string_view target;
+        if (line.compare(0, 4, "GET ") == 0) target = line.substr(4, line.find(' ', 4) - 4);
+        std::string_view path = target.substr(0, target.find('?'));
+        if (path != "/events") {
+            static const char missing[] =
+                "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            send(s.sock, missing, sizeof missing - 1, kSendFlags);
+            return false;
+        }
+        uint64_t since = 0;
+        bool resume = number(header(req, "last-event-id"), since) || number(param(target, "since"), since);
+        s.in.clear();
+        s.in.shrink_to_fit();
+        s.streaming = true;
+        s.out = "HTTP/1.1 200 OK\r\n"
+                "Content-Type: text/event-stream\r\n"
+                "Cache-Control: no-cache\r\n"
+                "Access-Control-Allow-Origin: *\r\n"
+                "Connection: keep-alive\r\n\r\n"
+                "retry: 2000\n\n";
+        // a since past version_ is fine: versions also move without an event
+        // (a rolled-back batch, a new day), see Database::changedRooms
+        if (!resume || since < floor_) {
+            // new subscriber, or one that missed more than the backlog holds:
+            // start from the current version
+            reset(s.out, version_);
+        } else {
+            auto it = std::upper_bound(backlog_.begin(), backlog_.end(), since,
+                                       [](uint64_t v, const Pending &p) { return v < p.version; });
+            for (; it != backlog_.end(); ++it) s.out += it->text;
+        }
+        return flush(s);
+    }
+
+    bool enqueue(Subscriber &s, std::string_view text) {
+        if (s.sent == s.out.size()) {
+            s.out.clear();
+            s.sent = 0;
+        }
+        if (s.out.size() - s.sent + text.size() > opts_.max_buffered) {
+            dropped_slow_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        s.out.append(text.data(), text.size());
+        return flush(s);
+    }
+
+    bool flush(Subscriber &s) {
+        while (s.sent < s.out.size()) {
+            int n = (int) send(s.sock, s.out.data() + s.sent, (int) (s.out.size() - s.sent), kSendFlags);
+            if (n < 0) return wouldBlock();
+            s.sent += (size_t) n;
+        }
+        return true;
+    }
+
+    void drop(Subscriber &s) {
+        if (s.sock == kNone) return;
+        closeSocket(s.sock);
+        s.sock = kNone;
+    }
+
+    static bool number(std::string_view v, uint64_t &out) {
+        if (v.empty()) return false;
+        auto r = std::from_chars(v.data(), v.data() + v.size(), out);
+        return r.ec == std::errc() && r.ptr == v.data() + v.size();
+    }
+
+    // Value of a request header (name in lower case), trimmed.
+    static std::string_view header(std::string_view req, std::string_view name) {
+        for (size_t pos = req.find("\r\n"); pos != std::string_view::npos;) {
+            size_t end = req.find("\r\n", pos + 2);
+            std::string_view h = req.substr(pos + 2, end == std::string_view::npos ? end : end - pos - 2);
+            pos = end;
+            size_t colon = h.find(':');
+            if (colon != name.size()) continue;
+            bool match = true;
+            for (size_t i = 0; i < colon && match; ++i) match = (h[i] | 0x20) == name[i];
+            if (!match) continue;
+            std::string_view v = h.substr(colon + 1);
+            while (!v.empty() && (v.front() == ' ' || v.front() == '\t')) v.remove_prefix(1);
+            while (!v.empty() && (v.back() == ' ' || v.back() == '\t')) v.remove_suffix(1);
+            return v;
+        }
+        return {};
+    }
+
+    static std::string_view param(std::string_view target, std::string_view name) {
+        size_t q = target.find('?');
+        if (q == std::string_view::npos) return {};
+        std::string_view qs = target.substr(q + 1);
+        while (!qs.empty()) {
+            size_t amp = qs.find('&');
+            std::string_view kv = qs.substr(0, amp);
+            qs = amp == std::string_view::npos ? std::string_view() : qs.substr(amp + 1);
+            if (kv.size() > name.size() && kv.compare(0, name.size(), name) == 0 && kv[name.size()] == '=')
+                return kv.substr(name.size() + 1);
+        }
+        return {};
+    }
+
+    EventOptions opts_;
+    socket_t listener_ = kNone;
+    socket_t wake_send_ = kNone, wake_recv_ = kNone;
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+
+    std::mutex mtx_;
+    std::deque<Pending> pending_;          // published, not yet sent
+
+    // fan-out thread only
+    std::vector<std::unique_ptr<Subscriber>> subs_;
+    std::deque<Pending> backlog_;          // oldest first
+    uint64_t floor_ = 0;                   // a client at this version or later can resume
+    uint64_t version_ = 0;                 // latest version sent
+
+    std::atomic<int> subscribers_{0};
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> dropped_slow_{0};
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+// Percent-decodes s ('+' is a space) and appends the result to out.
+// Returns false on a truncated or non-hex escape.
+inline bool url_decode(std::string_view s, std::string &out) {
+    auto hexval = [](char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    size_t run = 0;  // start of the pending stretch that needs no decoding
+    for (size_t i = 0; i < s.size(); ++i) {
+        char c = s[i];
+        if (c != '%' && c != '+') continue;
+        out.append(s.data() + run, i - run);
+        if (c == '+') {
+            out.push_back(' ');
+        } else {
+            if (i + 2 >= s.size()) return false;
+            int hi = hexval(s[i + 1]), lo = hexval(s[i + 2]);
+            if (hi < 0 || lo < 0) return false;
+            out.push_back((char) (hi * 16 + lo));
+            i += 2;
+        }
+        run = i + 1;
+    }
+    out.append(s.data() + run, s.size() - run);
+    return true;
+}
+
+// Zero-copy view of an application/x-www-form-urlencoded body (or query
+// string). parse() splits it once into string_views pointing at the
+// caller's buffer, which must outlive the FormView; values are only
+// decoded when a handler asks for them. Nothing here throws or allocates
+// except get() growing the caller's output buffer.
+class FormView {
+public:
+    static const int kMaxFields = 32;
+
+    // Returns false for bodies with more than kMaxFields fields.
+    bool parse(std::string_view body) {
+        count_ = 0;
+        size_t i = 0;
+        while (i <= body.size()) {
+            size_t amp = body.find('&', i);
+            if (amp == std::string_view::npos) amp = body.size();
+            std::string_view pair = body.substr(i, amp - i);
+            if (!pair.empty()) {
+                if (count_ == kMaxFields) return false;
+                size_t eq = pair.find('=');
+                Field &f = fields_[count_++];
+                f.key = pair.substr(0, eq);
+                f.value = eq == std::string_view::npos ? std::string_view() : pair.substr(eq + 1);
+            }
+            i = amp + 1;
+        }
+        return true;
+    }
+
+    // The still-encoded value of the first field called name.
+    bool raw(std::string_view name, std::string_view &value) const {
+        for (int i = 0; i < count_; ++i) {
+            if (keyEquals(fields_[i].key, name)) {
+                value = fields_[i].value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool has(std::string_view name) const {
+        std::string_view v;
+        return raw(name, v);
+    }
+
+    // Decodes the value of name into out (replacing its contents).
+    // Found::Missing leaves out empty; Found::Malformed means a bad escape.
+    enum class Found { Ok, Missing, Malformed };
+    Found get(std::string_view name, std::string &out) const {
+        out.clear();
+        std::string_view v;
+        if (!raw(name, v)) return Found::Missing;
+        return url_decode(v, out) ? Found::Ok : Found::Malformed;
+    }
+
+private:
+    struct Field {
+        std::string_view key;
+        std::string_view value;
+    };
+
+    // Field names are plain ASCII in practice; only decode a key when it
+    // actually carries escapes.
+    static bool keyEquals(std::string_view key, std::string_view name) {
+        if (key.find_first_of("%+") == std::string_view::npos) return key == name;
+        std::string decoded;
+        return url_decode(key, decoded) && decoded == name;
+    }
+
+    Field fields_[kMaxFields];
+    int count_ = 0;
+};
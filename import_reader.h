@@ -0,0 +1,241 @@
+#pragma once
+#include <charconv>
+#include <string>
+
+// One line of a bulk import file. Both formats carry the same columns;
+// which ones apply depends on the kind:
+//   room:    room_id, type, price, is_available
+//   booking: booking_id, customer_name, phone, room_id, check_in, check_out, status
+// CSV lines start with the kind and list the columns in that order, e.g.
+//   room,101,Single,1000,1
+//   booking,,"Sharma, Rahul",9800000000,101,2025-12-15,2025-12-18,active
+// JSONL lines are flat objects with a "kind" key and the column names as
+// keys. Missing or empty trailing columns are left unset.
+struct ImportRow {
+    enum Kind { Room, Booking } kind = Room;
+    static const int kMaxCols = 7;
+    std::string col[kMaxCols];
+    bool has[kMaxCols] = {};
+
+    void clear() {
+        for (int i = 0; i < kMaxCols; ++i) {
+            col[i].clear();   // keeps capacity, so steady-state parsing does not allocate
+            has[i] = false;
+        }
+    }
+};
+
+inline int import_columns(ImportRow::Kind k) { return k == ImportRow::Room ? 4 : 7; }
+
+inline const char *import_column_name(ImportRow::Kind k, int i) {
+    static const char *const room[] = {"room_id", "type", "price", "is_available"};
+    static const char *const booking[] = {"booking_id", "customer_name", "phone", "room_id",
+                                          "check_in", "check_out", "status"};
+    return k == ImportRow::Room ? room[i] : booking[i];
+}
+
+inline bool import_kind(const std::string &s, ImportRow::Kind &k) {
+    if (s == "room") k = ImportRow::Room;
+    else if (s == "booking") k = ImportRow::Booking;
+    else return false;
+    return true;
+}
+
+inline bool import_int(const std::string &s, long long &v) {
+    auto r = std::from_chars(s.data(), s.data() + s.size(), v);
+    return r.ec == std::errc() && r.ptr == s.data() + s.size() && !s.empty();
+}
+
+// Splits one CSV line (RFC 4180 quoting, no embedded newlines).
+inline bool parse_csv_row(const std::string &line, ImportRow &row, std::string &err) {
+    row.clear();
+    std::string kind;
+    size_t i = 0, n = line.size();
+    if (n && line[n - 1] == '\r') --n;
+    for (int f = -1; i <= n; ++f) {
+        if (f >= import_columns(row.kind)) {
+            err = "too many columns";
+            return false;
+        }
+        std::string &out = f < 0 ? kind : row.col[f];
+        if (i < n && line[i] == '"') {
+            for (++i;; ++i) {
+                if (i >= n) {
+                    err = "unterminated quote";
+                    return false;
+                }
+                if (line[i] == '"') {
+                    if (i + 1 < n && line[i + 1] == '"') ++i;
+                    else { ++i; break; }
+                }
+                out.push_back(line[i]);
+            }
+            if (i < n && line[i] != ',') {
+                err = "junk after quoted field";
+                return false;
+            }
+        } else {
+            size_t end = line.find(',', i);
+            if (end == std::string::npos || end > n) end = n;
+            out.append(line, i, end - i);
+            i = end;
+        }
+        if (f < 0) {
+            if (!import_kind(kind, row.kind)) {
+                err = "unknown kind '" + kind + "'";
+                return false;
+            }
+        } else {
+            row.has[f] = !out.empty();
+        }
+        ++i;  // skip the comma (or step past the end)
+    }
+    return true;
+}
+
+namespace import_detail {
+inline void skip_ws(const std::string &s, size_t &i) {
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) ++i;
+}
+
+inline void put_utf8(std::string &out, unsigned cp) {
+    if (cp < 0x80) out.push_back((char) cp);
+    else if (cp < 0x800) {
+        out.push_back((char) (0xC0 | (cp >> 6)));
+        out.push_back((char) (0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back((char) (0xE0 | (cp >> 12)));
+        out.push_back((char) (0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back((char) (0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back((char) (0xF0 | (cp >> 18)));
+        out.push_back((char) (0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back((char) (0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back((char) (0x80 | (cp & 0x3F)));
+    }
+}
+
+inline bool hex4(const std::string &s, size_t i, unsigned &v) {
+    if (i + 4 > s.size()) return false;
+    v = 0;
+    for (size_t k = i; k < i + 4; ++k) {
+        char c = s[k];
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= c - '0';
+        else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+        else return false;
+    }
+    return true;
+}
+
+// Reads a JSON string starting at the opening quote.
+inline bool read_string(const std::string &s, size_t &i, std::string &out) {
+    if (i >= s.size() || s[i] != '"') return false;
+    for (++i; i < s.size(); ++i) {
+        char c = s[i];
+        if (c == '"') { ++i; return true; }
+        if (c != '\\') { out.push_back(c); continue; }
+        if (++i >= s.size()) return false;
+        switch (s[i]) {
+            case '"': out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '/': out.push_back('/'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                unsigned cp;
+                if (!hex4(s, i + 1, cp)) return false;
+                i += 4;
+                if (cp >= 0xD800 && cp < 0xDC00) {
+                    unsigned lo;
+                    if (i + 2 >= s.size() || s[i + 1] != '\\' || s[i + 2] != 'u' ||
+                        !hex4(s, i + 3, lo) || lo < 0xDC00 || lo > 0xDFFF)
+                        return false;
+                    i += 6;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                put_utf8(out, cp);
+                break;
+            }
+            default: return false;
+        }
+    }
+    return false;
+}
+}
+
+// Parses one JSONL line: a flat object of string, number, boolean or null
+// values. Unknown keys are ignored; null counts as missing.
+inline bool parse_jsonl_row(const std::string &line, ImportRow &row, std::string &err) {
+    using namespace import_detail;
+    row.clear();
+    // values are collected first because "kind" may come after the columns
+    static const int kSlots = 8;
+    std::string key, val[kSlots];
+    std::string keys[kSlots];
+    bool present[kSlots] = {};
+    std::string kind;
+    int used = 0;
+
+    size_t i = 0;
+    skip_ws(line, i);
+    if (i >= line.size() || line[i] != '{') { err = "expected '{'"; return false; }
+    ++i;
+    skip_ws(line, i);
+    if (i < line.size() && line[i] == '}') { err = "missing kind"; return false; }
+    for (;;) {
+        key.clear();
+        skip_ws(line, i);
+        if (!read_string(line, i, key)) { err = "bad key"; return false; }
+        skip_ws(line, i);
+        if (i >= line.size() || line[i] != ':') { err = "expected ':'"; return false; }
+        ++i;
+        skip_ws(line, i);
+        std::string v;
+        bool is_null = false;
+        if (i < line.size() && line[i] == '"') {
+            if (!read_string(line, i, v)) { err = "bad string value"; return false; }
+        } else {
+            size_t start = i;
+            while (i < line.size() && line[i] != ',' && line[i] != '}' && line[i] != ' ' &&
+                   line[i] != '\t')
+                ++i;
+            v.assign(line, start, i - start);
+            if (v.empty() || v[0] == '{' || v[0] == '[') { err = "unsupported value for " + key; return false; }
+            if (v == "null") is_null = true;
+            else if (v == "true") v = "1";
+            else if (v == "false") v = "0";
+        }
+        if (key == "kind") kind = v;
+        else if (!is_null && used < kSlots) {
+            keys[used] = key;
+            val[used] = std::move(v);
+            present[used] = true;
+            ++used;
+        }
+        skip_ws(line, i);
+        if (i < line.size() && line[i] == ',') { ++i; continue; }
+        if (i < line.size() && line[i] == '}') break;
+        err = "expected ',' or '}'";
+        return false;
+    }
+    if (!import_kind(kind, row.kind)) {
+        err = "unknown kind '" + kind + "'";
+        return false;
+    }
+    for (int k = 0; k < used; ++k) {
+        if (!present[k]) continue;
+        for (int c = 0; c < import_columns(row.kind); ++c) {
+            if (keys[k] == import_column_name(row.kind, c)) {
+                row.col[c] = std::move(val[k]);
+                row.has[c] = !row.col[c].empty();
+                break;
+            }
+        }
+    }
+    return true;
+}
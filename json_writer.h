@@ -0,0 +1,104 @@
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Streaming JSON writer that appends into a caller-owned std::string.
+// Commas are inserted automatically; strings are escaped per RFC 8259 and
+// integers formatted with std::to_chars. Once the buffer has grown to a
+// response's size, reusing it (clear() keeps capacity) writes the next
+// response without allocating.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string &out) : out_(out) {}
+
+    JsonWriter &beginObject() { open('{'); return *this; }
+    JsonWriter &endObject() { close('}'); return *this; }
+    JsonWriter &beginArray() { open('['); return *this; }
+    JsonWriter &endArray() { close(']'); return *this; }
+
+    JsonWriter &key(std::string_view k) {
+        separate();
+        string(k);
+        out_.push_back(':');
+        after_key_ = true;
+        return *this;
+    }
+
+    JsonWriter &value(std::string_view v) { separate(); string(v); return *this; }
+    JsonWriter &value(const char *v) { return value(std::string_view(v)); }
+    JsonWriter &value(bool v) { separate(); out_.append(v ? "true" : "false"); return *this; }
+    JsonWriter &value(int v) { return value((int64_t) v); }
+    JsonWriter &value(unsigned v) { return value((uint64_t) v); }
+    JsonWriter &value(int64_t v) { separate(); number(v); return *this; }
+    JsonWriter &value(uint64_t v) { separate(); number(v); return *this; }
+
+    // Writes pre-serialized JSON as the next value.
+    JsonWriter &raw(std::string_view json) { separate(); out_.append(json); return *this; }
+
+private:
+    static const int kMaxDepth = 32;
+
+    void separate() {
+        if (after_key_) {
+            after_key_ = false;
+            return;
+        }
+        if (depth_ > 0 && depth_ <= kMaxDepth) {
+            if (has_items_[depth_ - 1]) out_.push_back(',');
+            has_items_[depth_ - 1] = true;
+        }
+    }
+
+    void open(char c) {
+        separate();
+        out_.push_back(c);
+        if (depth_ < kMaxDepth) has_items_[depth_] = false;
+        ++depth_;
+    }
+
+    void close(char c) {
+        out_.push_back(c);
+        if (depth_ > 0) --depth_;
+    }
+
+    template <class T>
+    void number(T v) {
+        char buf[24];
+        auto r = std::to_chars(buf, buf + sizeof buf, v);
+        out_.append(buf, r.ptr);
+    }
+
+    void string(std::string_view s) {
+        static const char hex[] = "0123456789abcdef";
+        out_.push_back('"');
+        size_t run = 0;  // start of the pending stretch that needs no escaping
+        for (size_t i = 0; i < s.size(); ++i) {
+            unsigned char c = (unsigned char) s[i];
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+            out_.append(s.data() + run, i - run);
+            run = i + 1;
+            switch (c) {
+                case '"': out_.append("\\\""); break;
+                case '\\': out_.append("\\\\"); break;
+                case '\n': out_.append("\\n"); break;
+                case '\r': out_.append("\\r"); break;
+                case '\t': out_.append("\\t"); break;
+                case '\b': out_.append("\\b"); break;
+                case '\f': out_.append("\\f"); break;
+                default: {
+                    char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+                    out_.append(esc, 6);
+                }
+            }
+        }
+        out_.append(s.data() + run, s.size() - run);
+        out_.push_back('"');
+    }
+
+    std::string &out_;
+    int depth_ = 0;
+    bool has_items_[kMaxDepth] = {};
+    bool after_key_ = false;
+};
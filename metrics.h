@@ -0,0 +1,252 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Log-linear latency histogram in nanoseconds, HDR style: 8 buckets per
+// power of two, so any recorded value is within 12.5% of its bucket's
+// bounds, from 1ns up to about 18 minutes. Each histogram has a single
+// writer (its thread) and any number of readers; counts are plain relaxed
+// atomics, so recording is a load and a store, never a locked instruction.
+class LatencyHistogram {
+public:
+    static const int kSubBits = 3;
+    static const int kSub = 1 << kSubBits;
+    static const int kBuckets = (40 - kSubBits + 1) * kSub;
+
+    static int bucketOf(uint64_t ns) {
+        if (ns < (uint64_t) kSub) return (int) ns;
+        int msb = 63 - clz(ns);
+        int b = (msb - kSubBits + 1) * kSub + (int) ((ns >> (msb - kSubBits)) & (kSub - 1));
+        return b < kBuckets ? b : kBuckets - 1;
+    }
+
+    // Exclusive upper bound of a bucket, in ns.
+    static uint64_t upperBound(int b) {
+        if (b < kSub) return (uint64_t) b + 1;
+        int shift = b / kSub - 1;
+        return (uint64_t) (kSub + b % kSub + 1) << shift;
+    }
+
+    void record(uint64_t ns) {
+        bump(counts_[bucketOf(ns)], 1);
+        bump(sum_, ns);
+    }
+
+    uint64_t count(int b) const { return counts_[b].load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+
+private:
+    static int clz(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_clzll(x);
+#else
+        int n = 0;
+        while (!(x & (1ULL << 63))) { x <<= 1; ++n; }
+        return n;
+#endif
+    }
+
+    // only the owning thread writes, so no read-modify-write is needed
+    static void bump(std::atomic<uint64_t> &c, uint64_t by) {
+        c.store(c.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> counts_[kBuckets] = {};
+    std::atomic<uint64_t> sum_{0};
+};
+
+// Request counters and latency per route, kept per worker thread and
+// summed when /metrics is scraped. begin() is called from the pre-routing
+// handler and end() from the logger of the same request, on the same
+// thread; neither takes a lock once the thread has its block.
+class HttpMetrics {
+public:
+    enum Route { Rooms, Book, Cancel, Other, kRoutes };
+
+    static Route routeOf(const std::string &method, const std::string &path) {
+        if (method == "GET" && path == "/rooms") return Rooms;
+        if (method == "POST" && (path == "/book" || path == "/book/batch")) return Book;
+        if (method == "POST" && (path == "/cancel" || path == "/cancel/batch")) return Cancel;
+        return Other;
+    }
+
+    void begin(Route r) {
+        Block &b = block();
+        b.route = r;
+        b.start = std::chrono::steady_clock::now();
+        b.pending = true;
+    }
+
+    // Returns the request's latency in ns. Requests rejected before routing
+    // (bad request line, too large) never saw begin(); they are not counted
+    // and get 0.
+    uint64_t end(int status) {
+        Block &b = block();
+        if (!b.pending) return 0;
+        b.pending = false;
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - b.start).count();
+        int cls = status / 100 - 1;
+        if (cls < 0 || cls >= kClasses) cls = kClasses - 1;
+        std::atomic<uint64_t> &c = b.requests[b.route][cls];
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        uint64_t latency = ns > 0 ? (uint64_t) ns : 0;
+        b.latency[b.route].record(latency);
+        return latency;
+    }
+
+    // Appends the Prometheus text format for every route: a request counter
+    // by status class, a latency histogram on fixed second buckets, and
+    // p50/p90/p99/p99.9 read off the full-resolution histogram.
+    void writePrometheus(std::string &out) const {
+        static const char *const names[kRoutes] = {"/rooms", "/book", "/cancel", "other"};
+        static const char *const classes[kClasses] = {"1xx", "2xx", "3xx", "4xx", "5xx"};
+        static const double les[] = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01,
+                                     0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+        static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+        const int kLes = sizeof(les) / sizeof(les[0]);
+
+        std::vector<uint64_t> requests(kRoutes * kClasses, 0);
+        std::vector<uint64_t> buckets(kRoutes * LatencyHistogram::kBuckets, 0);
+        std::vector<uint64_t> sums(kRoutes, 0);
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            for (const auto &b : blocks_) {
+                for (int r = 0; r < kRoutes; ++r) {
+                    for (int c = 0; c < kClasses; ++c)
+                        requests[r * kClasses + c] += b->requests[r][c].load(std::memory_order_relaxed);
+                    for (int i = 0; i < LatencyHistogram::kBuckets; ++i)
+                        buckets[r * LatencyHistogram::kBuckets + i] += b->latency[r].count(i);
+                    sums[r] += b->latency[r].sum();
+                }
+            }
+        }
+
+        out += "# HELP hotel_http_requests_total Requests served, by route and status class.\n"
+               "# TYPE hotel_http_requests_total counter\n";
+        for (int r = 0; r < kRoutes; ++r)
+            for (int c = 0; c < kClasses; ++c) {
+                out += "hotel_http_requests_total{route=\"";
+                out += names[r];
+                out += "\",code=\"";
+                out += classes[c];
+                out += "\"} ";
+                out += std::to_string(requests[r * kClasses + c]);
+                out += '\n';
+            }
+
+        out += "# HELP hotel_http_request_duration_seconds Time from routing to response sent.\n"
+               "# TYPE hotel_http_request_duration_seconds histogram\n";
+        for (int r = 0; r < kRoutes; ++r) {
+            const uint64_t *h = &buckets[r * LatencyHistogram::kBuckets];
+            uint64_t total = 0;
+            int i = 0;
+            for (int l = 0; l < kLes; ++l) {
+                // a bucket counts towards le once all of it lies below le
+                uint64_t le_ns = (uint64_t) (les[l] * 1e9);
+                for (; i < LatencyHistogram::kBuckets && LatencyHistogram::upperBound(i) <= le_ns; ++i)
+                    total += h[i];
+                line(out, "hotel_http_request_duration_seconds_bucket", names[r], "le", les[l], total);
+            }
+            for (; i < LatencyHistogram::kBuckets; ++i) total += h[i];
+            out += "hotel_http_request_duration_seconds_bucket{route=\"";
+            out += names[r];
+            out += "\",le=\"+Inf\"} " + std::to_string(total) + '\n';
+            out += "hotel_http_request_duration_seconds_sum{route=\"";
+            out += names[r];
+            out += "\"} " + seconds(sums[r]) + '\n';
+            out += "hotel_http_request_duration_seconds_count{route=\"";
+            out += names[r];
+            out += "\"} " + std::to_string(total) + '\n';
+        }
+
+        out += "# HELP hotel_http_request_latency_seconds Latency quantiles (upper bound of the "
+               "12.5%-wide bucket holding them).\n"
+               "# TYPE hotel_http_request_latency_seconds gauge\n";
+        for (int r = 0; r < kRoutes; ++r) {
+            const uint64_t *h = &buckets[r * LatencyHistogram::kBuckets];
+            uint64_t total = 0;
+            for (int i = 0; i < LatencyHistogram::kBuckets; ++i) total += h[i];
+            for (double q : quantiles) {
+                uint64_t rank = (uint64_t) (q * total), seen = 0;
+                uint64_t ns = 0;
+                for (int i = 0; total && i < LatencyHistogram::kBuckets; ++i) {
+                    seen += h[i];
+                    if (seen > rank) { ns = LatencyHistogram::upperBound(i); break; }
+                }
+                out += "hotel_http_request_latency_seconds{route=\"";
+                out += names[r];
+                out += "\",quantile=\"";
+                out += number(q);
+                out += "\"} " + seconds(ns) + '\n';
+            }
+        }
+    }
+
+private:
+    static const int kClasses = 5;
+
+    struct Block {
+        std::atomic<uint64_t> requests[kRoutes][kClasses] = {};
+        LatencyHistogram latency[kRoutes];
+        // the request in flight on this thread
+        Route route = Other;
+        std::chrono::steady_clock::time_point start;
+        bool pending = false;
+    };
+
+    // This thread's block, registered on first use. Blocks live as long as
+    // the HttpMetrics, so counts survive worker threads exiting.
+    Block &block() {
+        thread_local uint64_t owner = 0;
+        thread_local Block *mine = nullptr;
+        if (owner != id_) {
+            auto b = std::make_unique<Block>();
+            mine = b.get();
+            owner = id_;
+            std::lock_guard<std::mutex> lock(mtx_);
+            blocks_.push_back(std::move(b));
+        }
+        return *mine;
+    }
+
+    static std::string number(double v) {
+        std::string s = std::to_string(v);
+        s.erase(s.find_last_not_of('0') + 1);
+        if (s.back() == '.') s.pop_back();
+        return s;
+    }
+
+    static std::string seconds(uint64_t ns) {
+        std::string s = std::to_string(ns / 1000000000) + '.';
+        std::string frac = std::to_string(ns % 1000000000);
+        s.append(9 - frac.size(), '0');
+        return s + frac;
+    }
+
+    static void line(std::string &out, const char *metric, const char *route, const char *label,
+                     double v, uint64_t count) {
+        out += metric;
+        out += "{route=\"";
+        out += route;
+        out += "\",";
+        out += label;
+        out += "=\"";
+        out += number(v);
+        out += "\"} " + std::to_string(count) + '\n';
+    }
+
+    static uint64_t nextId() {
+        static std::atomic<uint64_t> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const uint64_t id_ = nextId();   // tells this thread's block apart from another instance's
+    mutable std::mutex mtx_;
+    std::vector<std::unique_ptr<Block>> blocks_;
+};
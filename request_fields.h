@@ -0,0 +1,81 @@
+#pragma once
+#include <charconv>
+#include <climits>
+#include <string>
+#include <string_view>
+#include "booking_index.h"
+#include "form_parser.h"
+
+// Why a request was rejected: which field, and what is wrong with it.
+// Both point at string literals.
+struct FieldError {
+    const char *field = "";
+    const char *reason = "";
+};
+
+// Typed, validated access to the fields of a FormView. Every getter
+// returns false on bad input and records the first error; nothing throws,
+// so junk requests cost a few comparisons rather than an exception
+// unwinding through the worker thread. Chain the calls with && and send
+// error() back as a 400 when one fails.
+class RequestFields {
+public:
+    explicit RequestFields(const FormView &form) : form_(form) {}
+
+    // Decoded text; rejects bad escapes and anything longer than max_len.
+    bool text(const char *name, std::string &out, size_t max_len, bool required = true) {
+        switch (form_.get(name, out)) {
+            case FormView::Found::Malformed: return fail(name, "is not valid url-encoding");
+            case FormView::Found::Missing:
+                return required ? fail(name, "is required") : true;
+            case FormView::Found::Ok: break;
+        }
+        if (required && out.empty()) return fail(name, "is required");
+        if (out.size() > max_len) return fail(name, "is too long");
+        return true;
+    }
+
+    // A base-10 integer in [min, max]. Leaves out untouched if the field is
+    // optional and absent.
+    bool integer(const char *name, int &out, int min, int max, bool required = true) {
+        std::string_view raw;
+        if (!form_.raw(name, raw) || raw.empty())
+            return required ? fail(name, "is required") : true;
+        int v = 0;
+        auto r = std::from_chars(raw.data(), raw.data() + raw.size(), v);
+        if (r.ec == std::errc::result_out_of_range) return fail(name, "is out of range");
+        if (r.ec != std::errc() || r.ptr != raw.data() + raw.size())
+            return fail(name, "must be a whole number");
+        if (v < min || v > max) return fail(name, "is out of range");
+        out = v;
+        return true;
+    }
+
+    // A YYYY-MM-DD date; day receives its day number and text the string.
+    bool date(const char *name, int &day, std::string &text, bool required = true) {
+        std::string_view raw;
+        if (!form_.raw(name, raw) || raw.empty())
+            return required ? fail(name, "is required") : true;
+        // dates never need decoding, so a '%' or '+' is already wrong
+        text.assign(raw.data(), raw.size());
+        if (!parse_date(text, day)) return fail(name, "must be a date (YYYY-MM-DD)");
+        return true;
+    }
+
+    // Records a cross-field problem (e.g. check_out before check_in).
+    bool fail(const char *field, const char *reason) {
+        if (!failed_) {
+            failed_ = true;
+            err_.field = field;
+            err_.reason = reason;
+        }
+        return false;
+    }
+
+    const FieldError &error() const { return err_; }
+
+private:
+    const FormView &form_;
+    FieldError err_;
+    bool failed_ = false;
+};
@@ -0,0 +1,8 @@
+-- Initial rooms, loaded once when hotel.db is first created.
+-- The schema itself lives in the migrations in database.cpp.
+
+INSERT INTO rooms (room_id, type, price, is_available) VALUES (101, 'Single', 1000, 1);
+INSERT INTO rooms (room_id, type, price, is_available) VALUES (102, 'Single', 1000, 1);
+INSERT INTO rooms (room_id, type, price, is_available) VALUES (201, 'Double', 2000, 1);
+INSERT INTO rooms (room_id, type, price, is_available) VALUES (301, 'Suite', 5000, 1);
+INSERT INTO rooms (room_id, type, price, is_available) VALUES (302, 'Suite', 5000, 1);
@@ -1,64 +1,281 @@
 #define _WIN32_WINNT 0x0A00 // for Windows 10 or higher
+// Compile: g++ -std=c++17 server.cpp database.cpp -o server.exe -lsqlite3 -lz -lws2_32
 #include <iostream>
-#include <sstream>
 #include <string>
-#include <map>
 #include <vector>
+#include <charconv>
+#include <climits>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include "httplib.h"   // https://github.com/yhirose/cpp-httplib (single header)
 #include "database.h"
+#include "json_writer.h"
+#include "form_parser.h"
+#include "request_fields.h"
+#include "metrics.h"
+#include "trace.h"
+#include "access_log.h"
+#include "config.h"
+#include "admission.h"
+#include "static_assets.h"
+#include "compress.h"
+#include "events.h"
+#include "booking_batch.h"
 
-// small helper: parse application/x-www-form-urlencoded body into map
-static std::string url_decode(const std::string &s) {
-    std::string out;
-    out.reserve(s.size());
-    for (size_t i = 0; i < s.size(); ++i) {
-        if (s[i] == '+') out.push_back(' ');
-        else if (s[i] == '%' && i + 2 < s.size()) {
-            std::string hex = s.substr(i + 1, 2);
-            char ch = (char) strtol(hex.c_str(), nullptr, 16);
-            out.push_back(ch);
-            i += 2;
-        } else {
-            out.push_back(s[i]);
+// serialize rooms as the JSON array returned by /rooms and /availability
+static void write_rooms(JsonWriter &w, const std::vector<Room> &rooms) {
+    w.beginArray();
+    for (const auto &r : rooms) {
+        w.beginObject();
+        w.key("room_id").value(r.room_id);
+        w.key("type").value(r.type);
+        w.key("price").value(r.price);
+        w.key("is_available").value(r.is_available);
+        w.endObject();
+    }
+    w.endArray();
+}
+
+// Per-worker scratch buffer for response bodies; keeps its capacity, so
+// serializing a response normally allocates nothing.
+static std::string &response_buffer() {
+    thread_local std::string buf;
+    buf.clear();
+    return buf;
+}
+
+// 400 with the offending field, e.g. {"field":"room_id","error":"must be a whole number"}
+static void send_field_error(httplib::Response &res, const FieldError &e) {
+    std::string &buf = response_buffer();
+    JsonWriter w(buf);
+    w.beginObject();
+    w.key("field").value(e.field);
+    w.key("error").value(e.reason);
+    w.endObject();
+    res.status = 400;
+    res.set_header("Access-Control-Allow-Origin", "*");
+    res.set_content(buf.data(), buf.size(), "application/json");
+}
+
+// The still-encoded query string of a request, for FormView; it points
+// into req.target, so it lives as long as the request.
+static std::string_view query_string(const httplib::Request &req) {
+    std::string_view target(req.target);
+    size_t q = target.find('?');
+    return q == std::string_view::npos ? std::string_view() : target.substr(q + 1);
+}
+
+// When API responses are gzipped: bodies of at least min_bytes, for
+// clients that accept it. level 0 turns compression off.
+struct Compression {
+    size_t min_bytes = 1024;
+    int level = 1;
+
+    bool wanted(const httplib::Request &req, size_t size) const {
+        return level > 0 && size >= min_bytes &&
+               accepts_encoding(req.get_header_value("Accept-Encoding"), "gzip");
+    }
+};
+
+// Sends body, gzipped if the Compression settings call for it. Each worker
+// keeps its own encoder and output buffer, so this allocates nothing once
+// warm.
+static void send_body(const Compression &c, const httplib::Request &req, httplib::Response &res,
+                      const std::string &body, const char *type) {
+    if (c.min_bytes <= body.size() && c.level > 0) res.set_header("Vary", "Accept-Encoding");
+    if (c.wanted(req, body.size())) {
+        thread_local std::unique_ptr<GzipEncoder> encoder;
+        thread_local int encoder_level = 0;
+        thread_local std::string out;
+        if (!encoder || encoder_level != c.level) {
+            encoder = std::make_unique<GzipEncoder>(c.level);
+            encoder_level = c.level;
+        }
+        if (encoder->encode(body, out) && out.size() < body.size()) {
+            res.set_header("Content-Encoding", "gzip");
+            res.set_content(out, type);
+            return;
         }
     }
-    return out;
+    res.set_content(body, type);
 }
 
-static std::map<std::string, std::string> parse_form_urlencoded(const std::string &body) {
-    std::map<std::string, std::string> m;
-    size_t i = 0;
-    while (i < body.size()) {
-        size_t eq = body.find('=', i);
-        if (eq == std::string::npos) break;
-        std::string key = body.substr(i, eq - i);
-        size_t amp = body.find('&', eq + 1);
-        std::string val;
-        if (amp == std::string::npos) {
-            val = body.substr(eq + 1);
-            i = body.size();
-        } else {
-            val = body.substr(eq + 1, amp - (eq + 1));
-            i = amp + 1;
+// Serialized /rooms body, reused until the catalog version or the date
+// (which decides is_available) moves on. gzip is compressed once per body,
+// at level 6 as it is served many times, when the body is big enough.
+struct RoomsCache {
+    std::mutex mtx;
+    uint64_t version = 0;
+    int day = 0;
+    std::shared_ptr<const std::string> body;
+    std::shared_ptr<const std::string> gzip;
+    std::string etag;
+};
+
+// Sends a UI file: gzip when the client takes it, cacheable for a year
+// when asked for by its versioned URL (?v=<hash>), else revalidated via
+// its ETag.
+static void serve_asset(const StaticAssets &assets, const std::string &name,
+                        const httplib::Request &req, httplib::Response &res) {
+    std::shared_ptr<const StaticAsset> a = assets.find(name);
+    if (!a) {
+        res.status = 404;
+        res.set_content("Not found", "text/plain");
+        return;
+    }
+    bool gz = !a->gzip.empty() && accepts_encoding(req.get_header_value("Accept-Encoding"), "gzip");
+    const std::string &etag = gz ? a->gzip_etag : a->etag;
+    res.set_header("ETag", etag);
+    res.set_header("Vary", "Accept-Encoding");
+    res.set_header("Cache-Control", req.has_param("v") && req.get_param_value("v") == a->hash
+                                        ? "public, max-age=31536000, immutable"
+                                        : "no-cache");
+    const std::string inm = req.get_header_value("If-None-Match");
+    if (!inm.empty() && (inm == "*" || inm.find(etag) != std::string::npos)) {
+        res.status = 304;
+        return;
+    }
+    if (gz) res.set_header("Content-Encoding", "gzip");
+    res.set_content(gz ? a->gzip : a->body, a->content_type);
+}
+
+// Worker pool counters for /metrics.
+struct PoolStats {
+    std::atomic<long> queued{0};       // connections waiting for a worker
+    std::atomic<long> busy{0};         // workers serving a connection
+    std::atomic<uint64_t> rejected{0}; // connections refused because the queue was full
+};
+
+// httplib's ThreadPool with a bound on waiting connections (0 = none).
+// Past the bound enqueue() fails and httplib closes the new connection at
+// once, rather than letting it sit behind a backlog it would time out in.
+class BoundedTaskQueue : public httplib::TaskQueue {
+public:
+    BoundedTaskQueue(size_t threads, size_t max_queued, PoolStats &stats)
+        : pool_(threads, max_queued), stats_(stats) {}
+
+    bool enqueue(std::function<void()> fn) override {
+        stats_.queued.fetch_add(1, std::memory_order_relaxed);
+        bool ok = pool_.enqueue([this, fn] {
+            stats_.queued.fetch_sub(1, std::memory_order_relaxed);
+            stats_.busy.fetch_add(1, std::memory_order_relaxed);
+            fn();
+            stats_.busy.fetch_sub(1, std::memory_order_relaxed);
+        });
+        if (!ok) {
+            stats_.queued.fetch_sub(1, std::memory_order_relaxed);
+            stats_.rejected.fetch_add(1, std::memory_order_relaxed);
         }
-        m[url_decode(key)] = url_decode(val);
+        return ok;
     }
-    return m;
+
+    void shutdown() override { pool_.shutdown(); }
+
+private:
+    httplib::ThreadPool pool_;
+    PoolStats &stats_;
+};
+
+// one Prometheus sample with its HELP and TYPE lines
+static void write_metric(std::string &out, const char *name, const char *type, const char *help,
+                         long long v) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+    out += name;
+    out += ' ';
+    out += std::to_string(v);
+    out += '\n';
 }
 
-int main() {
+int main(int argc, char **argv) {
+    ServerConfig cfg;
+    std::string err;
+    if (!config_load(cfg, argc, argv, err)) {
+        std::cerr << "Bad configuration: " << err << "\n";
+        return 2;
+    }
+    const size_t workers = cfg.workers > 0 ? (size_t) cfg.workers : CPPHTTPLIB_THREAD_POOL_COUNT;
+
+    // room changes pushed to /events subscribers, see events.h; declared
+    // before db so it outlives the writer thread that publishes to it
+    EventStream events{cfg.events};
+
     // initialize DB
     Database db;
-    const std::string dbfile = "hotel.db";
-    const std::string sqlfile = "schema.sql";
-
-    if (!db.open(dbfile, sqlfile)) {
+    int db_connections = cfg.db_connections > 0 ? cfg.db_connections : (int) workers;
+    if (!db.open(cfg.db_file, cfg.seed_file, db_connections, cfg.writer)) {
         std::cerr << "Failed to open/init DB\n";
         return 1;
     }
+    // a hot query that lost its index turns into a full table scan per request
+    for (const auto &q : db.fullScans())
+        std::cerr << "Warning: query does a full table scan: " << q << "\n";
+
+    if (cfg.events.port > 0) {
+        if (!events.start(cfg.host, db.catalogVersion())) return 1;
+        db.setChangeListener([&](const std::vector<RoomChange> &changes) { events.publish(changes); });
+    }
 
     httplib::Server svr;
 
+    // per-route counters and latency, exported at /metrics
+    HttpMetrics metrics;
+    // phase timings of sampled requests, see trace.h
+    Tracer tracer{cfg.trace};
+    AccessLog access_log{cfg.access_log};
+    PoolStats pool_stats;
+    Admission admission{cfg.admission, workers};
+    svr.new_task_queue = [&] {
+        return new BoundedTaskQueue(workers, (size_t) cfg.max_queued, pool_stats);
+    };
+    // responses go out as headers then body; with Nagle on, the body of the
+    // second and later responses on a keep-alive connection waits for the
+    // client's delayed ACK (~40 ms)
+    svr.set_tcp_nodelay(true);
+    svr.set_keep_alive_max_count((size_t) cfg.keep_alive_max_count);
+    svr.set_keep_alive_timeout(cfg.keep_alive_timeout);
+    svr.set_read_timeout(cfg.read_timeout, 0);
+    svr.set_write_timeout(cfg.write_timeout, 0);
+    svr.set_pre_routing_handler([&](const httplib::Request &req, httplib::Response &res) {
+        HttpMetrics::Route route = HttpMetrics::routeOf(req.method, req.path);
+        metrics.begin(route);
+        tracer.begin();
+        int retry_after = 0;
+        std::string client = admission.clientOf(req.remote_addr, req.get_header_value("X-Forwarded-For"));
+        Admission::Verdict v = admission.admit(route, client, retry_after);
+        if (v == Admission::Admit) return httplib::Server::HandlerResponse::Unhandled;
+        std::string &buf = response_buffer();
+        JsonWriter w(buf);
+        w.beginObject();
+        w.key("error").value(v == Admission::RateLimited ? "too many requests" : "server busy");
+        w.endObject();
+        res.status = v == Admission::RateLimited ? 429 : 503;
+        res.set_header("Retry-After", std::to_string(retry_after));
+        res.set_header("Access-Control-Allow-Origin", "*");
+        res.set_content(buf.data(), buf.size(), "application/json");
+        return httplib::Server::HandlerResponse::Handled;
+    });
+    svr.set_post_routing_handler([&](const httplib::Request &, httplib::Response &res) {
+        admission.release();
+        std::string timing;
+        if (tracer.serverTiming(timing)) res.set_header("Server-Timing", timing);
+    });
+    // runs once the response has been written
+    svr.set_logger([&](const httplib::Request &req, const httplib::Response &res) {
+        uint64_t latency = metrics.end(res.status);
+        access_log.record(req.method, req.path, res.status, latency, res.body.size(), req.remote_addr);
+        tracer.end(req.method, req.path, res.status);
+    });
+
     // CORS preflight (optional)
     svr.Options(".*", [](const httplib::Request& req, httplib::Response &res){
         res.set_header("Access-Control-Allow-Origin", "*");
@@ -67,43 +284,286 @@ int main() {
         res.status = 200;
     });
 
+    Compression compression;
+    compression.min_bytes = (size_t) cfg.compress_min_bytes;
+    compression.level = cfg.compress_level;
+
     // GET /rooms -> return JSON array of rooms
+    // GET /rooms?since=VERSION -> {"version":V,"full":false,"rooms":[...]}
+    //   with only the rooms that changed after VERSION, or "full":true and
+    //   every room when the change log no longer reaches back that far;
+    //   pass V as the next since
+    RoomsCache rooms_cache;
     svr.Get("/rooms", [&](const httplib::Request& req, httplib::Response &res) {
-        auto rooms = db.getRooms();
-        std::ostringstream oss;
-        oss << "[";
-        for (size_t i = 0; i < rooms.size(); ++i) {
-            const auto &r = rooms[i];
-            oss << "{";
-            oss << "\"room_id\":" << r.room_id << ",";
-            oss << "\"type\":\"" << r.type << "\",";
-            oss << "\"price\":" << r.price << ",";
-            oss << "\"is_available\":" << r.is_available;
-            oss << "}";
-            if (i + 1 < rooms.size()) oss << ",";
-        }
-        oss << "]";
-        res.set_header("Content-Type", "application/json");
+        if (req.has_param("since")) {
+            std::string v = req.get_param_value("since");
+            uint64_t since = 0;
+            auto r = std::from_chars(v.data(), v.data() + v.size(), since);
+            if (v.empty() || r.ec != std::errc() || r.ptr != v.data() + v.size()) {
+                send_field_error(res, FieldError{"since", "must be a catalog version"});
+                return;
+            }
+            std::vector<Room> rooms;
+            uint64_t version = 0;
+            bool delta;
+            {
+                TRACE_PHASE("db");
+                delta = db.changedRooms(since, rooms, version);
+                if (!delta) {
+                    // read after the version, so the rows are at least that new
+                    version = db.catalogVersion();
+                    rooms = db.getRooms();
+                }
+            }
+            TRACE_PHASE("serialize");
+            std::string &buf = response_buffer();
+            JsonWriter w(buf);
+            w.beginObject();
+            w.key("version").value(version);
+            w.key("full").value(!delta);
+            w.key("rooms");
+            write_rooms(w, rooms);
+            w.endObject();
+            res.set_header("Access-Control-Allow-Origin", "*");
+            res.set_header("Cache-Control", "no-store");
+            send_body(compression, req, res, buf, "application/json");
+            return;
+        }
+        uint64_t version = db.catalogVersion();
+        int day = today_day();
+        std::shared_ptr<const std::string> body, gzip;
+        std::string etag;
+        {
+            std::lock_guard<std::mutex> lock(rooms_cache.mtx);
+            if (rooms_cache.body && rooms_cache.version == version && rooms_cache.day == day) {
+                body = rooms_cache.body;
+                gzip = rooms_cache.gzip;
+                etag = rooms_cache.etag;
+            }
+        }
+        if (!body) {
+            // read after the version, so the body is at least that new
+            std::vector<Room> rooms;
+            {
+                TRACE_PHASE("db");
+                rooms = db.getRooms();
+            }
+            TRACE_PHASE("serialize");
+            std::string json;
+            JsonWriter w(json);
+            write_rooms(w, rooms);
+            if (compression.level > 0 && json.size() >= compression.min_bytes) {
+                TRACE_PHASE("compress");
+                std::string gz;
+                if (gzip_compress(json, gz, 6) && gz.size() < json.size())
+                    gzip = std::make_shared<const std::string>(std::move(gz));
+            }
+            body = std::make_shared<const std::string>(std::move(json));
+            etag = std::to_string(version) + "-" + std::to_string(day);
+            std::lock_guard<std::mutex> lock(rooms_cache.mtx);
+            if (version >= rooms_cache.version) {
+                rooms_cache.version = version;
+                rooms_cache.day = day;
+                rooms_cache.body = body;
+                rooms_cache.gzip = gzip;
+                rooms_cache.etag = etag;
+            }
+        }
+        // each encoding is its own representation with its own ETag
+        bool gz = gzip && compression.wanted(req, body->size());
+        etag = "\"" + etag + (gz ? "-gz\"" : "\"");
+        res.set_header("Access-Control-Allow-Origin", "*");
+        res.set_header("ETag", etag);
+        res.set_header("Cache-Control", "no-cache");
+        if (gzip) res.set_header("Vary", "Accept-Encoding");
+        const std::string inm = req.get_header_value("If-None-Match");
+        if (!inm.empty() && (inm == "*" || inm.find(etag) != std::string::npos)) {
+            res.status = 304;
+            return;
+        }
+        if (gz) res.set_header("Content-Encoding", "gzip");
+        res.set_content(gz ? *gzip : *body, "application/json");
+    });
+
+    // GET /events -> the event stream lives on its own port; EventSource
+    // follows the redirect and reconnects there directly
+    svr.Get("/events", [&](const httplib::Request& req, httplib::Response &res) {
+        res.set_header("Access-Control-Allow-Origin", "*");
+        if (cfg.events.port == 0) {
+            res.status = 404;
+            return;
+        }
+        std::string host = req.get_header_value("Host");
+        size_t colon = host.rfind(':');
+        if (colon != std::string::npos && host.find(']', colon) == std::string::npos) host.resize(colon);
+        if (host.empty()) host = "localhost";
+        std::string url = "http://" + host + ":" + std::to_string(cfg.events.port) + "/events";
+        std::string since = req.get_param_value("since");
+        if (!since.empty() && since.find_first_not_of("0123456789") == std::string::npos)
+            url += "?since=" + since;
+        res.set_redirect(url, 307);
+    });
+
+    // GET /metrics -> Prometheus text format
+    svr.Get("/metrics", [&](const httplib::Request& req, httplib::Response &res) {
+        std::string &buf = response_buffer();
+        metrics.writePrometheus(buf);
+        DbStats st = db.dbStats();
+        write_metric(buf, "hotel_sqlite_memory_used_bytes", "gauge",
+                     "Memory held by SQLite.", st.memory_used);
+        write_metric(buf, "hotel_sqlite_memory_highwater_bytes", "gauge",
+                     "Peak memory held by SQLite.", st.memory_highwater);
+        write_metric(buf, "hotel_sqlite_mallocs", "gauge",
+                     "Outstanding SQLite allocations.", st.malloc_count);
+        write_metric(buf, "hotel_sqlite_pagecache_overflow_bytes", "gauge",
+                     "Page cache memory that did not fit the page cache pool.", st.pagecache_overflow);
+        write_metric(buf, "hotel_sqlite_cache_used_bytes", "gauge",
+                     "Page cache in use over all connections.", st.cache_used);
+        write_metric(buf, "hotel_sqlite_cache_hits_total", "counter", "Page cache hits.", st.cache_hit);
+        write_metric(buf, "hotel_sqlite_cache_misses_total", "counter", "Page cache misses.", st.cache_miss);
+        write_metric(buf, "hotel_sqlite_cache_writes_total", "counter",
+                     "Dirty pages written out.", st.cache_write);
+        write_metric(buf, "hotel_sqlite_stmt_used_bytes", "gauge",
+                     "Memory held by prepared statements.", st.stmt_used);
+        write_metric(buf, "hotel_db_connections", "gauge", "Connections in the pool.", st.connections);
+        write_metric(buf, "hotel_db_connections_idle", "gauge",
+                     "Connections not checked out.", st.idle_connections);
+        write_metric(buf, "hotel_db_write_queue_depth", "gauge",
+                     "Writes waiting for the writer thread.", (long long) st.write_queue);
+        write_metric(buf, "hotel_events_subscribers", "gauge", "Clients connected to /events.",
+                     events.subscribers());
+        write_metric(buf, "hotel_events_published_total", "counter",
+                     "Room changes sent to /events.", (long long) events.published());
+        write_metric(buf, "hotel_events_dropped_slow_total", "counter",
+                     "/events clients disconnected for falling behind.", (long long) events.droppedSlow());
+        write_metric(buf, "hotel_access_log_dropped_total", "counter",
+                     "Access log records dropped because a worker's buffer was full.",
+                     (long long) access_log.dropped());
+        write_metric(buf, "hotel_admission_rate_limited_total", "counter",
+                     "Requests refused with 429 because the client ran out of tokens.",
+                     (long long) admission.rateLimited());
+        write_metric(buf, "hotel_admission_busy_total", "counter",
+                     "Requests refused with 503 because their route was at its in-flight limit.",
+                     (long long) admission.busy());
+        write_metric(buf, "hotel_inflight_book", "gauge", "POST /book requests in flight.",
+                     admission.inflight(HttpMetrics::Book));
+        write_metric(buf, "hotel_inflight_cancel", "gauge", "POST /cancel requests in flight.",
+                     admission.inflight(HttpMetrics::Cancel));
+        write_metric(buf, "hotel_http_queue_depth", "gauge",
+                     "Connections waiting for a worker thread.",
+                     pool_stats.queued.load(std::memory_order_relaxed));
+        write_metric(buf, "hotel_http_queue_rejected_total", "counter",
+                     "Connections refused because the worker queue was full.",
+                     (long long) pool_stats.rejected.load(std::memory_order_relaxed));
+        write_metric(buf, "hotel_http_workers", "gauge", "Worker threads.", (long long) workers);
+        write_metric(buf, "hotel_http_workers_busy", "gauge",
+                     "Worker threads serving a connection.", pool_stats.busy.load(std::memory_order_relaxed));
+        send_body(compression, req, res, buf, "text/plain; version=0.0.4");
+    });
+
+    // GET /availability?from=YYYY-MM-DD&to=YYYY-MM-DD[&type=][&max_price=]
+    // -> rooms free for every night from `from` up to (not including) `to`
+    svr.Get("/availability", [&](const httplib::Request& req, httplib::Response &res) {
         res.set_header("Access-Control-Allow-Origin", "*");
-        res.set_content(oss.str(), "application/json");
+        AvailabilityQuery q;
+        {
+            TRACE_PHASE("parse");
+            FormView query;
+            if (!query.parse(query_string(req))) {
+                send_field_error(res, FieldError{"", "too many fields"});
+                return;
+            }
+            RequestFields f(query);
+            std::string from, to;
+            if (!f.date("from", q.from, from) ||
+                !f.date("to", q.to, to) ||
+                (q.to <= q.from && !f.fail("to", "must be after from")) ||
+                !f.text("type", q.type, 200, false) ||
+                !f.integer("max_price", q.max_price, 0, INT_MAX, false)) {
+                send_field_error(res, f.error());
+                return;
+            }
+        }
+        std::vector<Room> rooms;
+        {
+            TRACE_PHASE("lookup");
+            rooms = db.findAvailable(q);
+        }
+        TRACE_PHASE("serialize");
+        std::string &buf = response_buffer();
+        JsonWriter w(buf);
+        write_rooms(w, rooms);
+        send_body(compression, req, res, buf, "application/json");
+    });
+
+    // GET /calendar[?type=][&from=YYYY-MM-DD][&days=N]
+    // -> free room count of that type for each night, default today + 365
+    svr.Get("/calendar", [&](const httplib::Request& req, httplib::Response &res) {
+        res.set_header("Access-Control-Allow-Origin", "*");
+        int from = today_day(), days = 365;
+        std::string type;
+        {
+            FormView query;
+            if (!query.parse(query_string(req))) {
+                send_field_error(res, FieldError{"", "too many fields"});
+                return;
+            }
+            RequestFields f(query);
+            std::string from_text;
+            if (!f.date("from", from, from_text, false) ||
+                !f.integer("days", days, 1, 366, false) ||
+                !f.text("type", type, 200, false)) {
+                send_field_error(res, f.error());
+                return;
+            }
+        }
+        std::vector<int> free;
+        int total = 0;
+        if (!db.freeRoomCounts(type, from, days, free, total)) {
+            send_field_error(res, FieldError{"from", "is outside the calendar (today to a year ahead)"});
+            return;
+        }
+        std::string &buf = response_buffer();
+        JsonWriter w(buf);
+        w.beginObject();
+        w.key("from").value(format_date(from));
+        w.key("type").value(type);
+        w.key("total").value(total);
+        w.key("free").beginArray();
+        for (int n : free) w.value(n);
+        w.endArray();
+        w.endObject();
+        send_body(compression, req, res, buf, "application/json");
     });
 
     // POST /book (x-www-form-urlencoded)
     svr.Post("/book", [&](const httplib::Request& req, httplib::Response &res){
-        std::string body = req.body;
-        auto form = parse_form_urlencoded(body);
-        std::string name = form.count("name") ? form["name"] : "";
-        int room_id = form.count("room_id") ? std::stoi(form["room_id"]) : 0;
-        std::string check_in = form.count("check_in") ? form["check_in"] : "";
-        std::string check_out = form.count("check_out") ? form["check_out"] : "";
-
-        if (name.empty() || room_id == 0) {
-            res.status = 400;
-            res.set_content("Missing required fields (name, room_id).", "text/plain");
-            return;
+        std::string name, check_in, check_out;
+        int room_id = 0;
+        {
+            TRACE_PHASE("parse");
+            FormView form;
+            if (!form.parse(req.body)) {
+                send_field_error(res, FieldError{"", "too many fields"});
+                return;
+            }
+            RequestFields f(form);
+            int from = 0, to = 0;
+            if (!f.text("name", name, 200) ||
+                !f.integer("room_id", room_id, 1, INT_MAX) ||
+                !f.date("check_in", from, check_in) ||
+                !f.date("check_out", to, check_out) ||
+                (to <= from && !f.fail("check_out", "must be after check_in"))) {
+                send_field_error(res, f.error());
+                return;
+            }
         }
 
-        auto r = db.bookRoom(name, room_id, check_in, check_out);
+        BookingResult r;
+        {
+            TRACE_PHASE("db");
+            r = db.bookRoom(name, room_id, check_in, check_out);
+        }
         if (r.ok) {
             res.set_content(r.message, "text/plain");
         } else {
@@ -113,23 +573,137 @@ int main() {
         res.set_header("Access-Control-Allow-Origin", "*");
     });
 
+    // POST /book/batch with a JSON body (see booking_batch.h) -> books every
+    // room or none: 200 if all were booked, 409 with the reason for each
+    // one that could not be
+    svr.Post("/book/batch", [&](const httplib::Request& req, httplib::Response &res){
+        std::vector<BookingRequest> items;
+        {
+            TRACE_PHASE("parse");
+            std::string field;
+            const char *reason = "";
+            if (!parse_booking_batch(req.body, (size_t) cfg.batch_max_items, items, field, reason)) {
+                send_field_error(res, FieldError{field.c_str(), reason});
+                return;
+            }
+        }
+
+        std::vector<BookingResult> results;
+        bool ok;
+        {
+            TRACE_PHASE("db");
+            ok = db.bookRooms(items, results);
+        }
+        std::string &buf = response_buffer();
+        JsonWriter w(buf);
+        w.beginObject();
+        w.key("ok").value(ok);
+        w.key("booked").value(ok ? (int) items.size() : 0);
+        w.key("results").beginArray();
+        for (size_t i = 0; i < items.size(); ++i) {
+            w.beginObject();
+            w.key("room_id").value(items[i].room_id);
+            w.key("ok").value(results[i].ok);
+            if (results[i].ok) w.key("booking_id").value(results[i].booking_id);
+            else w.key("error").value(results[i].message);
+            w.endObject();
+        }
+        w.endArray();
+        w.endObject();
+        res.status = ok ? 200 : 409;
+        res.set_header("Access-Control-Allow-Origin", "*");
+        send_body(compression, req, res, buf, "application/json");
+    });
+
     // POST /cancel
     svr.Post("/cancel", [&](const httplib::Request& req, httplib::Response &res){
-        std::string body = req.body;
-        auto form = parse_form_urlencoded(body);
-        if (!form.count("booking_id")) {
-            res.status = 400;
-            res.set_content("Missing booking_id", "text/plain");
-            return;
+        int booking_id = 0;
+        {
+            TRACE_PHASE("parse");
+            FormView form;
+            if (!form.parse(req.body)) {
+                send_field_error(res, FieldError{"", "too many fields"});
+                return;
+            }
+            RequestFields f(form);
+            if (!f.integer("booking_id", booking_id, 1, INT_MAX)) {
+                send_field_error(res, f.error());
+                return;
+            }
+        }
+        BookingResult r;
+        {
+            TRACE_PHASE("db");
+            r = db.cancelBooking(booking_id);
         }
-        int booking_id = std::stoi(form["booking_id"]);
-        auto r = db.cancelBooking(booking_id);
         if (r.ok) res.set_content(r.message, "text/plain");
         else { res.status = 400; res.set_content(r.message, "text/plain"); }
         res.set_header("Access-Control-Allow-Origin", "*");
     });
 
-    std::cout << "Server started at http://localhost:18080\n";
-    svr.listen("0.0.0.0", 18080);
+    // POST /cancel/batch with a JSON body (see booking_batch.h) -> cancels by
+    // booking id, or by room and date range, in one transaction; reports
+    // each id (or each booking cancelled)
+    svr.Post("/cancel/batch", [&](const httplib::Request& req, httplib::Response &res){
+        CancelSelection sel;
+        {
+            TRACE_PHASE("parse");
+            std::string field;
+            const char *reason = "";
+            if (!parse_cancel_batch(req.body, (size_t) cfg.batch_max_items, sel, field, reason)) {
+                send_field_error(res, FieldError{field.c_str(), reason});
+                return;
+            }
+        }
+
+        std::vector<BookingResult> results;
+        bool ok;
+        {
+            TRACE_PHASE("db");
+            ok = db.cancelBookings(sel, results);
+        }
+        int cancelled = 0;
+        for (const auto &r : results) cancelled += r.ok;
+        std::string &buf = response_buffer();
+        JsonWriter w(buf);
+        w.beginObject();
+        w.key("cancelled").value(cancelled);
+        w.key("results").beginArray();
+        for (const auto &r : results) {
+            w.beginObject();
+            w.key("booking_id").value(r.booking_id);
+            w.key("ok").value(r.ok);
+            if (!r.ok) w.key("error").value(r.message);
+            w.endObject();
+        }
+        w.endArray();
+        w.endObject();
+        res.status = ok ? 200 : 500;
+        res.set_header("Access-Control-Allow-Origin", "*");
+        send_body(compression, req, res, buf, "application/json");
+    });
+
+    // the UI, from memory; registered last so the API routes match first
+    std::unique_ptr<StaticAssets> assets;
+    if (!cfg.static_dir.empty()) {
+        assets = std::make_unique<StaticAssets>(cfg.static_dir,
+                                                std::chrono::milliseconds(cfg.static_reload_ms),
+                                                std::vector<std::string>{cfg.trace.file, cfg.access_log.file});
+        svr.Get("/", [&](const httplib::Request& req, httplib::Response &res) {
+            serve_asset(*assets, "index.html", req, res);
+        });
+        svr.Get(R"(/([A-Za-z0-9_.-]+))", [&](const httplib::Request& req, httplib::Response &res) {
+            serve_asset(*assets, req.matches[1], req, res);
+        });
+    }
+
+    std::cout << "Server started at http://" << cfg.host << ":" << cfg.port << " (" << workers
+              << " workers)\n";
+    if (cfg.events.port > 0)
+        std::cout << "Events at http://" << cfg.host << ":" << cfg.events.port << "/events\n";
+    if (!svr.listen(cfg.host, cfg.port)) {
+        std::cerr << "Cannot listen on " << cfg.host << ":" << cfg.port << "\n";
+        return 1;
+    }
     return 0;
 }
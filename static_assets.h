@@ -0,0 +1,199 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "compress.h"
+
+// One file of the UI, ready to send.
+struct StaticAsset {
+    std::string name;           // e.g. "style.css"
+    std::string content_type;
+    std::string body;
+    std::string gzip;           // gzip of body; empty when that would not be smaller
+    std::string hash;           // content hash, also the ?v= that makes a URL cacheable forever
+    std::string etag;           // of body
+    std::string gzip_etag;      // of gzip
+};
+
+// The UI files (html, css, js, images) of one directory, held in memory
+// with a gzip copy and a content-hash ETag each. HTML pages have their
+// references to the other assets rewritten to name?v=<hash>, so those URLs
+// change whenever the file does and can be cached for a year; the pages
+// themselves are revalidated with the ETag. A background thread checks the
+// files' size and mtime every poll interval and swaps in a rebuilt set
+// when anything changed; requests only ever read the current set. Only the
+// UI file types below are served or watched; `outputs` are files the
+// server itself writes (trace, access log), never served even if they sit
+// in dir with a UI extension.
+class StaticAssets {
+public:
+    StaticAssets(std::string dir, std::chrono::milliseconds poll, const std::vector<std::string> &outputs = {})
+        : dir_(std::move(dir)), poll_(poll) {
+        std::error_code ec;
+        const auto root = std::filesystem::weakly_canonical(dir_, ec);
+        for (const auto &f : outputs) {
+            if (f.empty()) continue;
+            auto p = std::filesystem::weakly_canonical(f, ec);
+            if (!ec && p.parent_path() == root) outputs_.insert(p.filename().string());
+        }
+        reload();
+        if (poll_.count() > 0) watcher_ = std::thread(&StaticAssets::watch, this);
+    }
+
+    ~StaticAssets() {
+        if (!watcher_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        watcher_.join();
+    }
+
+    StaticAssets(const StaticAssets &) = delete;
+    StaticAssets &operator=(const StaticAssets &) = delete;
+
+    std::shared_ptr<const StaticAsset> find(std::string_view name) const {
+        std::shared_ptr<const Table> t = std::atomic_load(&table_);
+        auto it = t->find(name);
+        return it == t->end() ? nullptr : it->second;
+    }
+
+    size_t size() const { return std::atomic_load(&table_)->size(); }
+
+private:
+    using Table = std::map<std::string, std::shared_ptr<const StaticAsset>, std::less<>>;
+    struct Stamp {
+        std::filesystem::file_time_type mtime;
+        uintmax_t size;
+        bool operator!=(const Stamp &o) const { return mtime != o.mtime || size != o.size; }
+    };
+
+    static const char *typeOf(const std::string &ext) {
+        if (ext == ".html") return "text/html; charset=utf-8";
+        if (ext == ".css") return "text/css; charset=utf-8";
+        if (ext == ".js") return "application/javascript; charset=utf-8";
+        if (ext == ".svg") return "image/svg+xml";
+        if (ext == ".png") return "image/png";
+        if (ext == ".ico") return "image/x-icon";
+        return nullptr;
+    }
+
+    // FNV-1a, 64 bits, as 16 hex digits
+    static std::string contentHash(const std::string &s) {
+        uint64_t h = 14695981039346656037ULL;
+        for (unsigned char c : s) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        static const char hex[] = "0123456789abcdef";
+        std::string out(16, '0');
+        for (int i = 15; i >= 0; --i, h >>= 4) out[i] = hex[h & 15];
+        return out;
+    }
+
+    // Servable files in dir_ and their stamps.
+    std::map<std::string, Stamp> scan() const {
+        std::map<std::string, Stamp> out;
+        std::error_code ec;
+        for (std::filesystem::directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec)) {
+            const auto &p = it->path();
+            if (!it->is_regular_file(ec) || !typeOf(p.extension().string()) ||
+                outputs_.count(p.filename().string()))
+                continue;
+            Stamp st{it->last_write_time(ec), it->file_size(ec)};
+            if (!ec) out[p.filename().string()] = st;
+        }
+        return out;
+    }
+
+    void reload() {
+        std::map<std::string, Stamp> stamps = scan();
+        std::vector<std::shared_ptr<StaticAsset>> assets;
+        for (const auto &f : stamps) {
+            std::ifstream in(std::filesystem::path(dir_) / f.first, std::ios::binary);
+            if (!in) continue;
+            std::ostringstream ss;
+            ss << in.rdbuf();
+            auto a = std::make_shared<StaticAsset>();
+            a->name = f.first;
+            a->content_type = typeOf(std::filesystem::path(f.first).extension().string());
+            a->body = ss.str();
+            assets.push_back(std::move(a));
+        }
+        // hash everything but the pages first, so the pages can point at
+        // the versioned URLs
+        for (auto &a : assets)
+            if (!isPage(*a)) a->hash = contentHash(a->body);
+        for (auto &a : assets) {
+            if (!isPage(*a)) continue;
+            for (const auto &other : assets) {
+                if (isPage(*other)) continue;
+                replaceAll(a->body, '"' + other->name + '"', '"' + other->name + "?v=" + other->hash + '"');
+            }
+            a->hash = contentHash(a->body);
+        }
+        auto table = std::make_shared<Table>();
+        for (auto &a : assets) {
+            a->etag = '"' + a->hash + '"';
+            a->gzip_etag = '"' + a->hash + "-gz\"";
+            bool text = a->content_type.compare(0, 5, "text/") == 0 ||
+                        a->content_type.compare(0, 12, "application/") == 0 ||
+                        a->content_type == "image/svg+xml";
+            if (text && (!gzip_compress(a->body, a->gzip) || a->gzip.size() >= a->body.size()))
+                a->gzip.clear();
+            (*table)[a->name] = std::move(a);
+        }
+        std::shared_ptr<const Table> ready = std::move(table);
+        std::atomic_store(&table_, ready);
+        stamps_ = std::move(stamps);
+    }
+
+    void watch() {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                if (cv_.wait_for(lock, poll_, [this] { return stopping_; })) return;
+            }
+            bool changed = false;
+            std::map<std::string, Stamp> now = scan();
+            if (now.size() != stamps_.size()) changed = true;
+            for (auto a = now.begin(), b = stamps_.begin(); !changed && a != now.end(); ++a, ++b)
+                changed = a->first != b->first || a->second != b->second;
+            if (changed) {
+                reload();
+                std::cerr << "Reloaded " << size() << " static assets from " << dir_ << "\n";
+            }
+        }
+    }
+
+    static bool isPage(const StaticAsset &a) { return a.content_type.compare(0, 9, "text/html") == 0; }
+
+    static void replaceAll(std::string &s, const std::string &from, const std::string &to) {
+        for (size_t pos = s.find(from); pos != std::string::npos; pos = s.find(from, pos + to.size()))
+            s.replace(pos, from.size(), to);
+    }
+
+    std::string dir_;
+    std::chrono::milliseconds poll_;
+    std::set<std::string> outputs_;         // file names in dir_ not to serve
+    std::shared_ptr<const Table> table_ = std::make_shared<const Table>();
+    std::map<std::string, Stamp> stamps_;   // as of the last reload; watcher thread only
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    std::thread watcher_;
+};
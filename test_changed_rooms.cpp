@@ -0,0 +1,75 @@
+// test_changed_rooms.cpp
+// Books every room of a scratch hotel tonight from several threads while a
+// client polls changedRooms() the way /rooms?since= does, and checks the
+// client ends up having seen every room go booked. Exits non-zero if any
+// booking never reached it.
+// Compile: g++ -std=c++17 -O2 test_changed_rooms.cpp database.cpp -o test_changed_rooms.exe -lsqlite3 -lpthread
+// Usage:   test_changed_rooms.exe [rooms=20000] [threads=4] [scratch.db=test_changed_rooms.db]
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "database.h"
+#include "test_util.h"
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int threads = argc > 2 ? std::atoi(argv[2]) : 4;
+    const std::string dbfile = argc > 3 ? argv[3] : "test_changed_rooms.db";
+    remove_db(dbfile);
+    if (n <= 0 || threads <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [rooms] [threads] [scratch.db]\n";
+        return 2;
+    }
+
+    WriterOptions writer;
+    writer.change_log = n + 1024;
+    Database db;
+    if (!db.open(dbfile, "", 2, writer) || !import_rooms(db, dbfile, n)) {
+        std::cerr << "Failed to open/init DB\n";
+        return 1;
+    }
+
+    const std::string tonight = format_date(today_day()), tomorrow = format_date(today_day() + 1);
+    std::atomic<int> running{threads};
+    std::atomic<int> failed{0};
+    std::vector<std::thread> bookers;
+    for (int t = 0; t < threads; ++t)
+        bookers.emplace_back([&, t] {
+            for (int id = 1 + t; id <= n; id += threads)
+                if (!db.bookRoom("Stress", id, tonight, tomorrow).ok) ++failed;
+            --running;
+        });
+
+    // The client: start from the catalog as of now, then only ask for deltas.
+    std::vector<char> seen(n + 1, 0);
+    uint64_t since = db.catalogVersion();
+    long polls = 0;
+    bool done = false;
+    while (!done) {
+        done = running.load() == 0;  // one more poll after the last booking
+        std::vector<Room> changed;
+        uint64_t version = 0;
+        if (!db.changedRooms(since, changed, version)) {
+            std::cerr << "changedRooms(" << since << ") fell back to a full reload\n";
+            return 1;
+        }
+        for (const auto &r : changed)
+            if (r.room_id >= 1 && r.room_id <= n && !r.is_available) seen[r.room_id] = 1;
+        since = version;
+        ++polls;
+    }
+    for (auto &b : bookers) b.join();
+
+    int visible = 0;
+    for (int id = 1; id <= n; ++id) visible += seen[id];
+    int booked = n - failed.load();
+    std::cout << booked << " of " << n << " rooms booked, " << visible << " seen by the client over "
+              << polls << " polls\n";
+    db.close();
+    remove_db(dbfile);
+    return failed.load() == 0 && visible == n ? 0 : 1;
+}
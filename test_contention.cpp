@@ -0,0 +1,100 @@
+// test_contention.cpp
+// Hammers one hot room with bookRoom() from N threads, each asking for
+// random overlapping stays over the same few weeks, then reads back the
+// active bookings the DB holds for it and checks that no two share a night.
+// The threads are split over two Database instances on the same file, as
+// two server processes would be: neither's in-memory index sees the other's
+// bookings, so only the SQL overlap guard keeps them apart.
+// Reports throughput and double-bookings found; exits non-zero on any.
+// Compile: g++ -std=c++17 -O2 test_contention.cpp database.cpp -o test_contention.exe -lsqlite3 -lpthread
+// Usage:   test_contention.exe [threads=8, at least 2] [attempts per thread=500] [scratch.db=test_contention.db]
+//          (run where seed.sql is)
+
+#include <sqlite3.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "database.h"
+#include "test_util.h"
+
+int main(int argc, char **argv) {
+    int threads = argc > 1 ? std::atoi(argv[1]) : 8;
+    int attempts = argc > 2 ? std::atoi(argv[2]) : 500;
+    const std::string dbfile = argc > 3 ? argv[3] : "test_contention.db";
+    remove_db(dbfile);
+
+    Database dbs[2];
+    if (threads < 2 || attempts <= 0 || !dbs[0].open(dbfile, "seed.sql", threads) ||
+        !dbs[1].open(dbfile, "seed.sql", threads)) {
+        std::cerr << "Failed to open/init DB\n";
+        return 1;
+    }
+    std::vector<Room> rooms = dbs[0].getRooms();
+    if (rooms.empty()) {
+        std::cerr << "No rooms to book (is seed.sql here?)\n";
+        return 1;
+    }
+    const int room = rooms.front().room_id;
+    const int first_day = today_day() + 30, span = 28;
+
+    std::atomic<int> booked{0}, refused{0};
+    std::vector<std::thread> workers;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t)
+        workers.emplace_back([&, t] {
+            Database &db = dbs[t % 2];
+            std::mt19937 rng(t + 1);
+            for (int i = 0; i < attempts; ++i) {
+                int from = first_day + (int) (rng() % span);
+                int to = from + 1 + (int) (rng() % 4);
+                if (db.bookRoom("Contention", room, format_date(from), format_date(to)).ok) ++booked;
+                else ++refused;
+            }
+        });
+    for (auto &w : workers) w.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    dbs[0].close();
+    dbs[1].close();
+
+    // what actually got committed, straight from the file
+    sqlite3 *conn = nullptr;
+    sqlite3_stmt *st = nullptr;
+    std::vector<int> nights(span + 8, 0);
+    int rows = 0, doubles = 0;
+    bool ok = sqlite3_open(dbfile.c_str(), &conn) == SQLITE_OK &&
+              sqlite3_prepare_v2(conn, "SELECT check_in, check_out FROM bookings "
+                                       "WHERE room_id = ? AND status = 'active';", -1, &st, nullptr) == SQLITE_OK;
+    if (ok) {
+        sqlite3_bind_int(st, 1, room);
+        while (sqlite3_step(st) == SQLITE_ROW) {
+            int from = 0, to = 0;
+            if (!parse_date((const char *) sqlite3_column_text(st, 0), from) ||
+                !parse_date((const char *) sqlite3_column_text(st, 1), to) || from < first_day ||
+                to - first_day > (int) nights.size()) {
+                ok = false;
+                break;
+            }
+            ++rows;
+            for (int d = from; d < to; ++d)
+                if (nights[d - first_day]++) ++doubles;
+        }
+    }
+    sqlite3_finalize(st);
+    sqlite3_close(conn);
+    if (!ok) {
+        std::cerr << "Cannot read back the bookings of room " << room << "\n";
+        return 1;
+    }
+
+    int total = threads * attempts;
+    std::cout << threads << " threads over 2 Database instances x " << attempts << " bookings of room "
+              << room << ": " << booked << " booked, " << refused << " refused in " << secs << " s (" << total / secs << " req/s)\n"
+              << "  " << rows << " active bookings in the DB, " << doubles << " double-booked nights\n";
+    remove_db(dbfile);
+    return doubles == 0 && rows == booked.load() ? 0 : 1;
+}
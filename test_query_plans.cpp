@@ -0,0 +1,31 @@
+// test_query_plans.cpp
+// Query-plan regression check: runs EXPLAIN QUERY PLAN over every statement
+// Database caches (Database::fullScans) and fails if any hot query would
+// scan a whole table instead of using an index.
+// Compile: g++ -std=c++17 -O2 test_query_plans.cpp database.cpp -o test_query_plans.exe -lsqlite3 -lpthread
+// Usage:   test_query_plans.exe [hotel.db]   (no argument: a scratch DB built from seed.sql)
+
+#include <iostream>
+#include <string>
+#include "database.h"
+#include "test_util.h"
+
+int main(int argc, char **argv) {
+    const bool scratch = argc < 2;
+    const std::string dbfile = scratch ? "test_query_plans.db" : argv[1];
+    if (scratch)
+        remove_db(dbfile);
+
+    Database db;
+    if (!db.open(dbfile, "seed.sql", 1)) {
+        std::cerr << "Failed to open/init DB\n";
+        return 1;
+    }
+    std::vector<std::string> scans = db.fullScans();
+    for (const auto &q : scans) std::cout << "full table scan: " << q << "\n";
+    std::cout << (scans.empty() ? "every hot query uses an index\n" : "") << std::flush;
+    db.close();
+    if (scratch)
+        remove_db(dbfile);
+    return scans.empty() ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include "database.h"
+
+// Scratch-DB fixtures shared by the bench_*.cpp and test_*.cpp programs.
+
+// Deletes a scratch DB along with its -wal and -shm files.
+inline void remove_db(const std::string &dbfile) {
+    for (const char *suffix : {"", "-wal", "-shm"}) std::remove((dbfile + suffix).c_str());
+}
+
+// Writes an import file with write(std::ofstream &) (format in
+// import_reader.h), loads it into db with bulkImport and deletes it again.
+// Returns false if the file cannot be written or the load fails; rows the
+// import rejects are counted in stats.
+template <class Write>
+inline bool import_csv(Database &db, const std::string &csv, Write write, ImportStats &stats) {
+    {
+        std::ofstream out(csv);
+        write(out);
+        if (!out) {
+            std::remove(csv.c_str());
+            return false;
+        }
+    }
+    bool ok = db.bulkImport(csv, stats);
+    std::remove(csv.c_str());
+    return ok;
+}
+
+// Rooms 1..n, all Single at 1000 and in service, loaded through a CSV
+// next to dbfile.
+inline bool import_rooms(Database &db, const std::string &dbfile, int n) {
+    ImportStats stats;
+    return import_csv(db, dbfile + ".csv", [n](std::ofstream &out) {
+        for (int id = 1; id <= n; ++id) out << "room," << id << ",Single,1000,1\n";
+    }, stats) && stats.rooms == n;
+}
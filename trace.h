@@ -0,0 +1,239 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "json_writer.h"
+
+// Build with -DHOTEL_TRACING=0 to compile every timer below out.
+#ifndef HOTEL_TRACING
+#define HOTEL_TRACING 1
+#endif
+
+struct TraceOptions {
+    unsigned sample_every = 100;      // time one request in N per worker; 0 = off
+    bool server_timing = true;        // send a Server-Timing header on timed responses
+    std::string file = "trace.json";  // Chrome trace of timed requests; "" = none
+    size_t max_file_bytes = 64u << 20; // stop appending once the trace is this big
+};
+
+#if HOTEL_TRACING
+
+// Phases recorded for the request this thread is serving. Only sampled
+// requests are timed; for the rest each timer costs one branch.
+struct RequestTimer {
+    using clock = std::chrono::steady_clock;
+    static const int kMaxPhases = 8;
+    struct Phase {
+        const char *name;
+        clock::time_point start, end;
+    };
+
+    static RequestTimer &current() {
+        thread_local RequestTimer t;
+        return t;
+    }
+
+    void add(const char *name, clock::time_point a, clock::time_point b) {
+        if (count < kMaxPhases) phases[count++] = Phase{name, a, b};
+    }
+
+    bool active = false;
+    clock::time_point start, handled;
+    Phase phases[kMaxPhases];
+    int count = 0;
+};
+
+// Times the enclosing scope as one phase of the current request.
+class PhaseScope {
+public:
+    explicit PhaseScope(const char *name) : t_(RequestTimer::current()), name_(name) {
+        if (t_.active) start_ = RequestTimer::clock::now();
+    }
+    ~PhaseScope() {
+        if (t_.active) t_.add(name_, start_, RequestTimer::clock::now());
+    }
+    PhaseScope(const PhaseScope &) = delete;
+    PhaseScope &operator=(const PhaseScope &) = delete;
+
+private:
+    RequestTimer &t_;
+    const char *name_;
+    RequestTimer::clock::time_point start_;
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_PHASE(name) PhaseScope TRACE_CONCAT(trace_phase_, __LINE__)(name)
+
+// Samples requests, turns their phases into a Server-Timing header and
+// appends them to a Chrome trace (open it in chrome://tracing or
+// Perfetto). begin() runs before routing, serverTiming() just before the
+// response is written and end() once it has been, all on the worker
+// thread serving the request. end() only queues the formatted events; a
+// background thread appends them to the file and flushes, so a worker
+// never waits on the disk.
+class Tracer {
+public:
+    explicit Tracer(const TraceOptions &opts) : opts_(opts), epoch_(RequestTimer::clock::now()) {
+        if (!opts_.file.empty() && opts_.sample_every) {
+            out_.open(opts_.file, std::ios::out | std::ios::trunc);
+            // the closing ] is optional in this format, so a trace cut
+            // short by a crash still loads
+            if (out_) out_ << "[\n" << std::flush;
+            if (out_) writer_ = std::thread(&Tracer::writerLoop, this);
+        }
+    }
+
+    ~Tracer() {
+        if (!writer_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        writer_.join();
+    }
+
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+
+    void begin() {
+        thread_local unsigned seen = 0;
+        RequestTimer &t = RequestTimer::current();
+        t.active = false;
+        if (!opts_.sample_every || ++seen < opts_.sample_every) return;
+        seen = 0;
+        t.active = true;
+        t.count = 0;
+        t.start = RequestTimer::clock::now();
+    }
+
+    // Marks the handler done. Returns true with the header value if this
+    // request was timed and Server-Timing is enabled.
+    bool serverTiming(std::string &value) {
+        RequestTimer &t = RequestTimer::current();
+        if (!t.active) return false;
+        t.handled = RequestTimer::clock::now();
+        if (!opts_.server_timing) return false;
+        value.clear();
+        for (int i = 0; i < t.count; ++i) {
+            value += t.phases[i].name;
+            value += ";dur=";
+            value += millis(t.phases[i].end - t.phases[i].start);
+            value += ", ";
+        }
+        value += "total;dur=";
+        value += millis(t.handled - t.start);
+        return true;
+    }
+
+    void end(const std::string &method, const std::string &path, int status) {
+        RequestTimer &t = RequestTimer::current();
+        if (!t.active) return;
+        t.active = false;
+        auto done = RequestTimer::clock::now();
+        if (t.handled < t.start) t.handled = done;  // never reached serverTiming()
+        if (!writer_.joinable()) return;
+
+        thread_local int tid = next_tid_.fetch_add(1, std::memory_order_relaxed);
+        std::string name = method + " " + path;
+        std::string lines;
+        event(lines, name.c_str(), "request", t.start, done, tid, status);
+        for (int i = 0; i < t.count; ++i)
+            event(lines, t.phases[i].name, "phase", t.phases[i].start, t.phases[i].end, tid, -1);
+        event(lines, "write", "phase", t.handled, done, tid, -1);
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (written_ + lines.size() > opts_.max_file_bytes) return;
+            written_ += lines.size();
+            pending_ += lines;
+        }
+        cv_.notify_one();
+    }
+
+private:
+    void writerLoop() {
+        std::string batch;
+        for (;;) {
+            bool stop;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+                batch.swap(pending_);
+                stop = stopping_;
+            }
+            if (!batch.empty()) {
+                out_ << batch;
+                out_.flush();   // the server is normally stopped by a signal
+                batch.clear();
+            }
+            if (stop) return;
+        }
+    }
+
+    using duration = RequestTimer::clock::duration;
+
+    static std::string millis(duration d) {
+        long long us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        std::string frac = std::to_string(us % 1000);
+        return std::to_string(us / 1000) + '.' + std::string(3 - frac.size(), '0') + frac;
+    }
+
+    std::string micros(RequestTimer::clock::time_point t) const {
+        long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t - epoch_).count();
+        std::string frac = std::to_string(ns % 1000);
+        return std::to_string(ns / 1000) + '.' + std::string(3 - frac.size(), '0') + frac;
+    }
+
+    // one complete ("X") event per line
+    void event(std::string &out, const char *name, const char *cat, RequestTimer::clock::time_point a,
+               RequestTimer::clock::time_point b, int tid, int status) const {
+        JsonWriter w(out);
+        w.beginObject();
+        w.key("name").value(name);
+        w.key("cat").value(cat);
+        w.key("ph").value("X");
+        w.key("ts").raw(micros(a));
+        w.key("dur").raw(micros(epoch_ + (b - a)));
+        w.key("pid").value(1);
+        w.key("tid").value(tid);
+        if (status >= 0) {
+            w.key("args").beginObject();
+            w.key("status").value(status);
+            w.endObject();
+        }
+        w.endObject();
+        out += ",\n";
+    }
+
+    TraceOptions opts_;
+    RequestTimer::clock::time_point epoch_;
+    std::ofstream out_;             // writer thread only
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::string pending_;           // events not yet written
+    size_t written_ = 0;            // bytes accepted for the file, queued or written
+    bool stopping_ = false;
+    std::thread writer_;
+    std::atomic<int> next_tid_{1};
+};
+
+#else
+
+#define TRACE_PHASE(name) ((void) 0)
+
+class Tracer {
+public:
+    explicit Tracer(const TraceOptions &) {}
+    void begin() {}
+    bool serverTiming(std::string &) { return false; }
+    void end(const std::string &, const std::string &, int) {}
+};
+
+#endif